@@ -0,0 +1,180 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../dulljson.h"
+
+/* compares minifying an indented document with parsing it, in GB/s of input.
+ * the numbers only mean something in an optimized build (CMAKE_BUILD_TYPE=Release) */
+
+typedef struct {
+    char* s;
+    size_t len, size;
+} buffer;
+
+static int write_buffer(void* user, const char* data, size_t len) {
+    buffer* b = (buffer*)user;
+    if (b->len + len > b->size) {
+        while (b->len + len > b->size)
+            b->size = b->size ? b->size * 2 : 65536;
+        b->s = (char*)realloc(b->s, b->size);
+    }
+    memcpy(b->s + b->len, data, len);
+    b->len += len;
+    return 0;
+}
+
+static void put(buffer* b, char ch) {
+    write_buffer(b, &ch, 1);
+}
+
+static void indent(buffer* b, int depth) {
+    int i;
+    put(b, '\n');
+    for (i = 0; i < depth * 4; i++)
+        put(b, ' ');
+}
+
+/* re-indents compact JSON the way a pretty printer would */
+static void pretty(buffer* out, const char* p, size_t len) {
+    const char* end = p + len;
+    int depth = 0;
+    while (p < end) {
+        char ch = *p++;
+        switch (ch) {
+        case '"':
+            put(out, ch);
+            while (*p != '"') {
+                if (*p == '\\')
+                    put(out, *p++);
+                put(out, *p++);
+            }
+            put(out, *p++);
+            break;
+        case '[':
+        case '{':
+            put(out, ch);
+            indent(out, ++depth);
+            break;
+        case ']':
+        case '}':
+            indent(out, --depth);
+            put(out, ch);
+            break;
+        case ',':
+            put(out, ch);
+            indent(out, depth);
+            break;
+        case ':':
+            put(out, ch);
+            put(out, ' ');
+            break;
+        default:
+            put(out, ch);
+        }
+    }
+    put(out, '\n');
+}
+
+static void generate(buffer* out, size_t count) {
+    static const char* tags[] = { "red", "green", "blue", "with \"quotes\"", "\xE2\x82\xAC" };
+    char buf[65536], name[32];
+    buffer compact = { NULL, 0, 0 };
+    dull_writer w;
+    size_t i;
+    dull_writer_init(&w, buf, sizeof(buf), write_buffer, &compact);
+    dull_writer_begin_array(&w);
+    for (i = 0; i < count; i++) {
+        dull_writer_begin_object(&w);
+        dull_writer_key(&w, "id", 2);
+        dull_writer_number(&w, (double)i);
+        dull_writer_key(&w, "name", 4);
+        dull_writer_string(&w, name, sprintf(name, "item-%zu", i));
+        dull_writer_key(&w, "price", 5);
+        dull_writer_number(&w, i * 0.25 + 0.1);
+        dull_writer_key(&w, "active", 6);
+        dull_writer_boolean(&w, i % 3 != 0);
+        dull_writer_key(&w, "tags", 4);
+        dull_writer_begin_array(&w);
+        dull_writer_string(&w, tags[i % 5], strlen(tags[i % 5]));
+        dull_writer_string(&w, tags[(i + 1) % 5], strlen(tags[(i + 1) % 5]));
+        dull_writer_end_array(&w);
+        dull_writer_end_object(&w);
+    }
+    dull_writer_end_array(&w);
+    dull_writer_flush(&w);
+    pretty(out, compact.s, compact.len);
+    put(out, '\0');
+    out->len--;
+    free(compact.s);
+}
+
+static double now_s() {
+    return (double)clock() / CLOCKS_PER_SEC;
+}
+
+static int compare_double(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return x < y ? -1 : x > y;
+}
+
+#define MAX_ROUNDS 64
+
+static void report(const char* name, double* seconds, int rounds, size_t bytes) {
+    qsort(seconds, rounds, sizeof(double), compare_double);
+    printf("%-18s %8.2f ms %8.2f GB/s\n", name, seconds[rounds / 2] * 1e3, bytes / seconds[rounds / 2] / 1e9);
+}
+
+int main(int argc, char* argv[]) {
+    size_t count = argc > 1 ? (size_t)strtoul(argv[1], NULL, 10) : 400000;
+    int i, rounds = argc > 2 ? atoi(argv[2]) : 5;
+    double parse_s[MAX_ROUNDS], minify_s[MAX_ROUNDS], reescape_s[MAX_ROUNDS], inplace_s[MAX_ROUNDS];
+    buffer json = { NULL, 0, 0 };
+    char* out;
+    char* scratch;
+    size_t out_len, len;
+    double start;
+    dull_value v;
+
+    if (rounds < 1 || rounds > MAX_ROUNDS)
+        rounds = 5;
+    generate(&json, count);
+    out = (char*)malloc(json.len);
+    scratch = (char*)malloc(json.len + 1);
+    DULL_INIT(&v);
+
+    for (i = 0; i < rounds; i++) {
+        start = now_s();
+        if (dull_parse(&v, json.s) != DULL_PARSE_OK) {
+            fprintf(stderr, "the generated document doesn't parse\n");
+            return 1;
+        }
+        parse_s[i] = now_s() - start;
+        dull_free(&v);
+
+        start = now_s();
+        dull_minify(json.s, json.len, out, &out_len, 0);
+        minify_s[i] = now_s() - start;
+
+        start = now_s();
+        dull_minify(json.s, json.len, out, &out_len, DULL_MINIFY_REESCAPE);
+        reescape_s[i] = now_s() - start;
+
+        memcpy(scratch, json.s, json.len + 1);
+        len = json.len;
+        start = now_s();
+        dull_minify_inplace(scratch, &len, 0);
+        inplace_s[i] = now_s() - start;
+    }
+
+    printf("%zu records, %.1f MB indented, %.1f MB minified, %d rounds (median)\n",
+        count, json.len / 1e6, out_len / 1e6, rounds);
+    report("dull_parse", parse_s, rounds, json.len);
+    report("dull_minify", minify_s, rounds, json.len);
+    report("  REESCAPE", reescape_s, rounds, json.len);
+    report("  inplace", inplace_s, rounds, json.len);
+    free(json.s);
+    free(out);
+    free(scratch);
+    return 0;
+}
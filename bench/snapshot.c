@@ -0,0 +1,90 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../dulljson.h"
+
+/* compares parsing a document as text with reloading its binary snapshot */
+
+#define JSON_PATH "bench_snapshot.json"
+#define SNAPSHOT_PATH "bench_snapshot.bin"
+
+static int write_file(void* user, const char* data, size_t len) {
+    return fwrite(data, 1, len, (FILE*)user) == len ? 0 : -1;
+}
+
+static void generate(const char* path, size_t count) {
+    static const char* tags[] = { "red", "green", "blue", "with \"quotes\"", "\xE2\x82\xAC" };
+    char buf[65536], name[32];
+    dull_writer w;
+    size_t i;
+    FILE* fp = fopen(path, "wb");
+    if (fp == NULL) {
+        perror(path);
+        exit(1);
+    }
+    dull_writer_init(&w, buf, sizeof(buf), write_file, fp);
+    dull_writer_begin_array(&w);
+    for (i = 0; i < count; i++) {
+        dull_writer_begin_object(&w);
+        dull_writer_key(&w, "id", 2);
+        dull_writer_number(&w, (double)i);
+        dull_writer_key(&w, "name", 4);
+        dull_writer_string(&w, name, sprintf(name, "item-%zu", i));
+        dull_writer_key(&w, "price", 5);
+        dull_writer_number(&w, i * 0.25 + 0.1);
+        dull_writer_key(&w, "active", 6);
+        dull_writer_boolean(&w, i % 3 != 0);
+        dull_writer_key(&w, "tags", 4);
+        dull_writer_begin_array(&w);
+        dull_writer_string(&w, tags[i % 5], strlen(tags[i % 5]));
+        dull_writer_string(&w, tags[(i + 1) % 5], strlen(tags[(i + 1) % 5]));
+        dull_writer_end_array(&w);
+        dull_writer_end_object(&w);
+    }
+    dull_writer_end_array(&w);
+    if (dull_writer_flush(&w) != DULL_WRITE_OK) {
+        fprintf(stderr, "%s: write failed\n", path);
+        exit(1);
+    }
+    fclose(fp);
+}
+
+static double now_ms() {
+    return clock() * 1000.0 / CLOCKS_PER_SEC;
+}
+
+int main(int argc, char* argv[]) {
+    size_t count = argc > 1 ? (size_t)strtoul(argv[1], NULL, 10) : 200000;
+    int i, rounds = argc > 2 ? atoi(argv[2]) : 5;
+    double start, parse_ms = 0, load_ms = 0;
+    dull_value v;
+
+    generate(JSON_PATH, count);
+    DULL_INIT(&v);
+    if (dull_parse_file(&v, JSON_PATH, 0) != DULL_PARSE_OK || dull_save_snapshot(&v, SNAPSHOT_PATH) != 0) {
+        fprintf(stderr, "failed to prepare the snapshot\n");
+        return 1;
+    }
+    dull_free(&v);
+
+    for (i = 0; i < rounds; i++) {
+        start = now_ms();
+        dull_parse_file(&v, JSON_PATH, 0);
+        parse_ms += now_ms() - start;
+        dull_free(&v);
+
+        start = now_ms();
+        dull_load_snapshot(&v, SNAPSHOT_PATH);
+        load_ms += now_ms() - start;
+        dull_free(&v);
+    }
+
+    printf("%zu records, %d rounds\n", count, rounds);
+    printf("text parse:    %10.2f ms\n", parse_ms / rounds);
+    printf("snapshot load: %10.2f ms\n", load_ms / rounds);
+    printf("speedup:       %10.2fx\n", parse_ms / load_ms);
+    remove(JSON_PATH);
+    remove(SNAPSHOT_PATH);
+    return 0;
+}
@@ -1,3 +1,10 @@
+/* mmap flags and friends are extensions that strict -std=c99/c11 hides */
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE
+#endif
+#if defined(__APPLE__) && !defined(_DARWIN_C_SOURCE)
+#define _DARWIN_C_SOURCE
+#endif
 #include "dulljson.h"
 #include <assert.h>
 #include <stdlib.h>
@@ -5,50 +12,295 @@
 #include <string.h>
 #include <errno.h>
 #include <math.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/*
+ * the few atomic operations dull_document needs: C11 atomics where the compiler
+ * has them, otherwise the GCC builtins or MSVC's interlocked intrinsics, so the
+ * rest of the library still builds as C99. DULL_ATOMIC_DEC returns the new count.
+ */
+#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L && !defined(__STDC_NO_ATOMICS__)
+#include <stdatomic.h>
+typedef atomic_size_t dull_atomic_count;
+typedef _Atomic(void*) dull_atomic_ptr;
+#define DULL_ATOMIC_INIT(p, x) atomic_init(p, x)
+#define DULL_ATOMIC_INC(p) atomic_fetch_add_explicit(p, 1, memory_order_relaxed)
+#define DULL_ATOMIC_DEC(p) (atomic_fetch_sub_explicit(p, 1, memory_order_acq_rel) - 1)
+#define DULL_ATOMIC_LOAD(p) atomic_load_explicit(p, memory_order_acquire)
+#define DULL_ATOMIC_CAS(p, expected, desired) \
+    atomic_compare_exchange_strong_explicit(p, expected, desired, memory_order_acq_rel, memory_order_acquire)
+#elif defined(__GNUC__)
+typedef size_t dull_atomic_count;
+typedef void* dull_atomic_ptr;
+#define DULL_ATOMIC_INIT(p, x) (*(p) = (x))
+#define DULL_ATOMIC_INC(p) __atomic_fetch_add(p, 1, __ATOMIC_RELAXED)
+#define DULL_ATOMIC_DEC(p) __atomic_sub_fetch(p, 1, __ATOMIC_ACQ_REL)
+#define DULL_ATOMIC_LOAD(p) __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define DULL_ATOMIC_CAS(p, expected, desired) \
+    __atomic_compare_exchange_n(p, expected, desired, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+#elif defined(_MSC_VER)
+#include <intrin.h>
+typedef volatile long dull_atomic_count;
+typedef void* volatile dull_atomic_ptr;
+#define DULL_ATOMIC_INIT(p, x) (*(p) = (x))
+#define DULL_ATOMIC_INC(p) _InterlockedIncrement(p)
+#define DULL_ATOMIC_DEC(p) _InterlockedDecrement(p)
+#define DULL_ATOMIC_LOAD(p) _InterlockedCompareExchangePointer(p, NULL, NULL)
+#define DULL_ATOMIC_CAS(p, expected, desired) dull_atomic_cas(p, expected, desired)
+static int dull_atomic_cas(dull_atomic_ptr* p, void** expected, void* desired)
+{
+    void* old = _InterlockedCompareExchangePointer(p, desired, *expected);
+    if (old == *expected)
+        return 1;
+    *expected = old;
+    return 0;
+}
+#else
+#error "dulljson needs C11 atomics, GCC builtins or MSVC intrinsics"
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#define DULL_HAVE_MMAP
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#endif
 
 #define EXPECT(c, ch) do{ assert(*c->json == (ch)); c->json++; }while(0)
 
 #define ISDIGIT(ch) ((ch) >= '0' && (ch) <= '9')
 #define ISDIGIT1TO9(ch) ((ch) >= '1' && (ch) <= '9')
 #define PUTC(c, ch) do{*(char*)dull_context_push((c), sizeof(char)) = (ch);} while(0)
-#define STRING_ERROR(ret) do { c->top = head; return ret; } while(0)
+#define STRING_ERROR(ret) do { c->top = head; c->json = q; return ret; } while(0)
+
+#ifdef DULL_PARSE_STATS
+#include <time.h>
+#define STAT(c, stmt) do { dull_parse_stats* dull_st_ = (c)->stats; if (dull_st_ != NULL) { stmt; } } while(0)
+#define STAT_CLOCK(c, t) double t = (c)->stats != NULL ? dull_now_ns() : 0
+#else
+#define STAT(c, stmt) do { } while(0)
+#define STAT_CLOCK(c, t)
+#endif
 
 #ifndef DULL_PARSE_STACK_INIT_SIZE
 #define DULL_PARSE_STACK_INIT_SIZE 256
 #endif
 
-typedef struct
+/* the public reader is the parser's own context */
+typedef dull_reader dull_context;
+
+#ifdef DULL_PARSE_STATS
+static double dull_now_ns(void)
 {
-    const char* json;
-    char* stack;
-    size_t top, size;
-} dull_context;
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+#endif
+
+
+#define DULL_ALIGN(n) (((n) + sizeof(double) - 1) & ~(sizeof(double) - 1))
+
+/* v's string, element or member array and keys were allocated for v alone */
+#define DULL_OWNS_STORAGE(v) (!((v)->flags & (DULL_F_BLOCK | DULL_F_POOLED)) || ((v)->flags & DULL_F_DETACHED))
+/* nothing below v points into a block that v doesn't keep alive, so v can be moved bitwise */
+#define DULL_MOVABLE(v) (!((v)->flags & (DULL_F_POOLED | DULL_F_DETACHED)) || ((v)->flags & DULL_F_BLOCK))
+
+/*
+ * a DULL_F_BLOCK root keeps its block alive through a slot just before its own
+ * storage. the slot is NULL while that storage opens the block; once the root
+ * has grown into an allocation of its own, the slot holds the block left behind.
+ */
+#define DULL_BLOCK_SLOT DULL_ALIGN(sizeof(char*))
+
+static char* dull_block_alloc(size_t size)
+{
+    char* base = (char*)malloc(DULL_BLOCK_SLOT + size);
+    if (base == NULL)
+        return NULL;
+    *(char**)base = NULL;
+    return base + DULL_BLOCK_SLOT;
+}
+
+static char* dull_block_realloc(char* storage, size_t size)
+{
+    return (char*)realloc(storage - DULL_BLOCK_SLOT, DULL_BLOCK_SLOT + size) + DULL_BLOCK_SLOT;
+}
 
+static void dull_block_free(char* storage)
+{
+    char* base = storage - DULL_BLOCK_SLOT;
+    free(*(char**)base);
+    free(base);
+}
+
+static void dull_free_storage(dull_value* v, void* storage)
+{
+    if (v->flags & DULL_F_BLOCK)
+        dull_block_free((char*)storage);
+    else if (DULL_OWNS_STORAGE(v))
+        free(storage);
+}
 
 void dull_free(dull_value* v)
 {
     assert(v != NULL);
+    /* pooled storage belongs to an ancestor's block, only owned children are released */
+    int own_keys = DULL_OWNS_STORAGE(v);
     switch (v->type)
     {
     case DULL_STRING:
-        free(v->u.s.s);
+        dull_free_storage(v, v->u.s.s);
         break;
     case DULL_ARRAY:
         for(int i = 0 ; i < v->u.a.size; i++)
             dull_free(&v->u.a.e[i]);
-        free(v->u.a.e);
+        dull_free_storage(v, v->u.a.e);
         break;
     case DULL_OBJECT:
         for (int i = 0; i < v->u.o.size; i++) {
-            free(v->u.o.m[i].k);
+            if (own_keys)
+                free(v->u.o.m[i].k);
             dull_free(&v->u.o.m[i].v);
         }
-        free(v->u.o.m);
+        dull_free_storage(v, v->u.o.m);
         break;
     default:
         break;
     }
     v->type = DULL_NULL;
+    v->flags = 0;
+}
+
+/* bytes of v's own storage: element or member array, or string bytes */
+static size_t dull_storage_size(const dull_value* v)
+{
+    switch (v->type)
+    {
+    case DULL_STRING: return DULL_ALIGN(v->u.s.len + 1);
+    case DULL_ARRAY:  return sizeof(dull_value) * v->u.a.size;
+    case DULL_OBJECT: return sizeof(dull_member) * v->u.o.size;
+    default:          return 0;
+    }
+}
+
+static char* dull_storage(const dull_value* v)
+{
+    switch (v->type)
+    {
+    case DULL_STRING: return v->u.s.s;
+    case DULL_ARRAY:  return (char*)v->u.a.e;
+    case DULL_OBJECT: return (char*)v->u.o.m;
+    default:          return NULL;
+    }
+}
+
+/* bytes needed to hold the storage of v and all of its descendants */
+static size_t dull_subtree_size(const dull_value* v)
+{
+    size_t i, size = dull_storage_size(v);
+    if (v->type == DULL_ARRAY)
+        for (i = 0; i < v->u.a.size; i++)
+            size += dull_subtree_size(&v->u.a.e[i]);
+    else if (v->type == DULL_OBJECT)
+        for (i = 0; i < v->u.o.size; i++)
+            size += DULL_ALIGN(v->u.o.m[i].klen + 1) + dull_subtree_size(&v->u.o.m[i].v);
+    return size;
+}
+
+/* copies src into dst, carving dst's storage out of *cur */
+static void dull_copy_pooled(dull_value* dst, const dull_value* src, char** cur, unsigned flags)
+{
+    size_t i, size = dull_storage_size(src);
+    char* p = *cur;
+    *cur += size;
+    *dst = *src;
+    dst->flags = size ? flags : 0;
+    switch (src->type)
+    {
+    case DULL_STRING:
+        memcpy(dst->u.s.s = p, src->u.s.s, src->u.s.len + 1);
+        memset(p + src->u.s.len + 1, 0, size - src->u.s.len - 1);
+        break;
+    case DULL_ARRAY:
+        dst->u.a.e = size ? (dull_value*)p : NULL;
+        dst->u.a.capacity = src->u.a.size;
+        for (i = 0; i < src->u.a.size; i++)
+            dull_copy_pooled(&dst->u.a.e[i], &src->u.a.e[i], cur, DULL_F_POOLED);
+        break;
+    case DULL_OBJECT:
+        dst->u.o.m = size ? (dull_member*)p : NULL;
+        dst->u.o.capacity = src->u.o.size;
+        for (i = 0; i < src->u.o.size; i++) {
+            dull_member* m = &dst->u.o.m[i];
+            m->klen = src->u.o.m[i].klen;
+            memcpy(m->k = *cur, src->u.o.m[i].k, m->klen + 1);
+            memset(m->k + m->klen + 1, 0, DULL_ALIGN(m->klen + 1) - m->klen - 1);
+            *cur += DULL_ALIGN(m->klen + 1);
+            dull_copy_pooled(&m->v, &src->u.o.m[i].v, cur, DULL_F_POOLED);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+void dull_copy(dull_value* dst, const dull_value* src)
+{
+    assert(dst != NULL && src != NULL && dst != src);
+    size_t size = dull_subtree_size(src);
+    char* block = size ? dull_block_alloc(size) : NULL;
+    char* cur = block;
+    dull_value tmp;
+    /* the root's own storage comes first, so freeing it releases the whole block */
+    dull_copy_pooled(&tmp, src, &cur, DULL_F_BLOCK);
+    assert(cur == block + size);
+    dull_free(dst);
+    memcpy(dst, &tmp, sizeof(dull_value));
+}
+
+void dull_move(dull_value* dst, dull_value* src)
+{
+    dull_value tmp;
+    assert(dst != NULL && src != NULL && dst != src);
+    /* src may live inside dst, so it leaves the tree before dst is freed */
+    if (!DULL_MOVABLE(src)) {
+        /* the storage can't outlive its block, so take a copy instead */
+        DULL_INIT(&tmp);
+        dull_copy(&tmp, src);
+        dull_free(src);
+    }
+    else {
+        memcpy(&tmp, src, sizeof(dull_value));
+        DULL_INIT(src);
+    }
+    dull_free(dst);
+    memcpy(dst, &tmp, sizeof(dull_value));
+}
+
+void dull_swap(dull_value* lhs, dull_value* rhs)
+{
+    assert(lhs != NULL && rhs != NULL);
+    if (lhs == rhs)
+        return;
+    if (!DULL_MOVABLE(lhs) || !DULL_MOVABLE(rhs)) {
+        dull_value tmp;
+        DULL_INIT(&tmp);
+        dull_copy(&tmp, lhs);
+        dull_copy(lhs, rhs);
+        dull_move(rhs, &tmp);
+        return;
+    }
+    dull_value tmp;
+    memcpy(&tmp, lhs, sizeof(dull_value));
+    memcpy(lhs, rhs, sizeof(dull_value));
+    memcpy(rhs, &tmp, sizeof(dull_value));
 }
 
 static void dull_parse_whitespace(dull_context* c)
@@ -62,31 +314,16 @@ static void dull_parse_whitespace(dull_context* c)
 static int dull_parse_literal(dull_context* c, dull_value* v, const char* literal, dull_type t)
 {
     assert(literal != NULL);
-    
-    size_t index = 0;
-    int size = strlen(literal);
-    int c_size = strlen(c->json);
 
-    while(index < size)
-    {
-        if(index >= c_size || c->json[index] != literal[index])
-        {
+    /* a terminator in the input mismatches, so this never reads past it */
+    size_t i;
+    for (i = 0; literal[i]; i++)
+        if (c->json[i] != literal[i])
             return DULL_PARSE_INVALID_VALUE;
-        }
-        index++;
-    }
 
-    c->json += size;
+    c->json += i;
     v->type = t;
     return DULL_PARSE_OK;
-    // size_t i;
-    // EXPECT(c, literal[0]);
-    // for (i = 0; literal[i + 1]; i++)
-    //     if (c->json[i] != literal[i + 1])
-    //         return DULL_PARSE_INVALID_VALUE;
-    // c->json += i;
-    // v->type = t;
-    // return DULL_PARSE_OK;
 }
 
 static int dull_parse_number(dull_context* c, dull_value* v)
@@ -168,7 +405,8 @@ void dull_set_string(dull_value* v, const char* c, size_t len)
     assert(v != NULL && (c != NULL || len == 0));
     dull_free(v);
     v->u.s.s = (char*)malloc(len + 1);
-    memcpy(v->u.s.s, c, len);
+    if (len)
+        memcpy(v->u.s.s, c, len);
     v->u.s.s[len] = '\0';
     v->u.s.len = len;
     v->type = DULL_STRING;
@@ -192,7 +430,8 @@ static void* dull_context_push(dull_context* c, size_t size)
 
         while(c->top + size >= c->size)
             c->size += c->size  >> 1;
-            
+
+        STAT(c, if (c->stack == NULL) dull_st_->stack_allocs++; else dull_st_->stack_reallocs++);
         c->stack = (char*)realloc(c->stack, c->size);
     }
 
@@ -207,6 +446,19 @@ static void* dull_context_pop(dull_context* c, size_t size)
     return c->stack + (c->top-=size);
 }
 
+/* byte an escape letter decodes to, 0 if the letter is not a valid escape ('u' is handled apart) */
+static const char dull_unescape[256] = {
+    ['"'] = '"', ['\\'] = '\\', ['/'] = '/',
+    ['b'] = '\b', ['f'] = '\f', ['n'] = '\n', ['r'] = '\r', ['t'] = '\t'
+};
+
+/* escape letter a byte is written with, 'u' for \u00XX, 0 if it is written as is */
+static const char dull_escape[256] = {
+    'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'b', 't', 'n', 'u', 'f', 'r', 'u', 'u',
+    'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+    ['"'] = '"', ['\\'] = '\\'
+};
+
 static const char* dull_parse_hex4(const char* p, unsigned* u)
 {
     int i;
@@ -248,10 +500,13 @@ static int dull_parse_string_raw(dull_context* c, char** str, size_t* len)
     size_t head = c->top;
     EXPECT(c, '\"');
     const char* p = c->json;
+    const char* q; /* start of the current char or escape, reported on error */
     unsigned u, u2;
+    STAT_CLOCK(c, t0);
 
     for(;;)
     {
+        q = p;
         char ch = *p++;
         switch(ch)
         {
@@ -260,18 +515,12 @@ static int dull_parse_string_raw(dull_context* c, char** str, size_t* len)
                 *str = dull_context_pop(c, *len);
                 // dull_set_string(v, tc, len);
                 c->json = p;
+                STAT(c, dull_st_->string_bytes += *len; dull_st_->string_ns += dull_now_ns() - t0);
                 return DULL_PARSE_OK;
             case '\\':
+                STAT(c, dull_st_->escapes++);
                 switch (*p++)
                 {
-                    case '\"': PUTC(c, '\"'); break;
-                    case '\\': PUTC(c, '\\'); break;
-                    case '/': PUTC(c, '/'); break;
-                    case 'b': PUTC(c, '\b'); break;
-                    case 'f': PUTC(c, '\f'); break;
-                    case 'n': PUTC(c, '\n'); break;
-                    case 'r': PUTC(c, '\r'); break;
-                    case 't': PUTC(c, '\t'); break;
                     case 'u':
                         if (!(p = dull_parse_hex4(p, &u)))
                             STRING_ERROR(DULL_PARSE_INVALID_UNICODE_HEX);
@@ -289,7 +538,9 @@ static int dull_parse_string_raw(dull_context* c, char** str, size_t* len)
                         dull_encode_utf8(c, u);
                         break;
                     default:
-                        STRING_ERROR(DULL_PARSE_INVALID_STRING_ESCAPE);
+                        if (!(ch = dull_unescape[(unsigned char)p[-1]]))
+                            STRING_ERROR(DULL_PARSE_INVALID_STRING_ESCAPE);
+                        PUTC(c, ch);
                 }
                 break;
             case '\0': 
@@ -307,8 +558,10 @@ static int dull_parse_string(dull_context* c, dull_value* v)
     size_t len;
     char* str;
     int ret;
-    if((ret = dull_parse_string_raw(c,&str, &len)) == DULL_PARSE_OK)
+    if((ret = dull_parse_string_raw(c,&str, &len)) == DULL_PARSE_OK) {
         dull_set_string(v, str, len);
+        STAT(c, dull_st_->heap_allocs++);
+    }
 
     // printf("%d",ret);
     return ret;
@@ -319,17 +572,29 @@ static int dull_parse_array(dull_context* c, dull_value* v);
 
 static int dull_parse_value(dull_context* c, dull_value* v)
 {
+    int ret;
     switch (*c->json)
     {
-        case 'n': return dull_parse_literal(c, v, "null", DULL_NULL);
-        case 't': return dull_parse_literal(c, v, "true", DULL_TRUE);
-        case 'f': return dull_parse_literal(c, v, "false", DULL_FALSE);
-        case '"' : return dull_parse_string(c, v);
-        case '[': return dull_parse_array(c, v);
-        case '{': return dull_parse_obj(c, v);
-        default : return dull_parse_number(c, v);
+        case 'n': ret = dull_parse_literal(c, v, "null", DULL_NULL); break;
+        case 't': ret = dull_parse_literal(c, v, "true", DULL_TRUE); break;
+        case 'f': ret = dull_parse_literal(c, v, "false", DULL_FALSE); break;
+        case '"' : ret = dull_parse_string(c, v); break;
+        case '[':
+        case '{':
+            STAT(c, if (++c->depth > dull_st_->max_depth) dull_st_->max_depth = c->depth);
+            ret = *c->json == '[' ? dull_parse_array(c, v) : dull_parse_obj(c, v);
+            STAT(c, c->depth--);
+            break;
+        default : {
+            STAT_CLOCK(c, t0);
+            ret = dull_parse_number(c, v);
+            STAT(c, dull_st_->number_ns += dull_now_ns() - t0);
+            break;
+        }
         case '\0': return DULL_PARSE_EXPECT_VALUE;
     }
+    STAT(c, if (ret == DULL_PARSE_OK) dull_st_->nodes[v->type]++);
+    return ret;
 }
 
 // ["adb",[1,2],3,"c"]
@@ -342,7 +607,7 @@ static int dull_parse_array(dull_context* c, dull_value* v)
         c->json++;
         v->type = DULL_ARRAY;
         v->u.a.e = NULL;
-        v->u.a.size = 0;
+        v->u.a.size = v->u.a.capacity = 0;
         return DULL_PARSE_OK;
     }
 
@@ -369,9 +634,10 @@ static int dull_parse_array(dull_context* c, dull_value* v)
         else if(*c->json == ']')
         {   
             len = c->top - head;
+            STAT(c, dull_st_->heap_allocs++);
             v->u.a.e = (dull_value*)malloc(len);
             memcpy(v->u.a.e,dull_context_pop(c, len), len);
-            v->u.a.size = size;
+            v->u.a.size = v->u.a.capacity = size;
             v->type = DULL_ARRAY;
             c->json++;
             return DULL_PARSE_OK;
@@ -400,7 +666,7 @@ static int dull_parse_obj(dull_context* c, dull_value* v)
         c->json++;
         v->type = DULL_OBJECT;
         v->u.o.m = 0;
-        v->u.o.size = 0;
+        v->u.o.size = v->u.o.capacity = 0;
         return DULL_PARSE_OK;
     }
     m.k = NULL;
@@ -414,8 +680,11 @@ static int dull_parse_obj(dull_context* c, dull_value* v)
         }
         if ((ret = dull_parse_string_raw(c, &str, &m.klen)) != DULL_PARSE_OK)
             break;
-        memcpy(m.k = (char*)malloc(m.klen + 1), str, m.klen);
+        m.k = (char*)malloc(m.klen + 1);
+        if (m.klen)
+            memcpy(m.k, str, m.klen);
         m.k[m.klen] = '\0';
+        STAT(c, dull_st_->heap_allocs++);
         dull_parse_whitespace(c);
         if (*c->json != ':') {
             ret = DULL_PARSE_MISS_COLON;
@@ -437,7 +706,8 @@ static int dull_parse_obj(dull_context* c, dull_value* v)
             size_t s = sizeof(dull_member) * size;
             c->json++;
             v->type = DULL_OBJECT;
-            v->u.o.size = size;
+            v->u.o.size = v->u.o.capacity = size;
+            STAT(c, dull_st_->heap_allocs++);
             memcpy(v->u.o.m = (dull_member*)malloc(s), dull_context_pop(c, s), s);
             return DULL_PARSE_OK;
         }
@@ -456,7 +726,7 @@ static int dull_parse_obj(dull_context* c, dull_value* v)
     return ret;
 }
 
-size_t dull_get_array_size(dull_value* v)
+size_t dull_get_array_size(const dull_value* v)
 {
     assert(v != NULL && v->type == DULL_ARRAY);
     return v->u.a.size;
@@ -470,7 +740,295 @@ dull_value* dull_get_array_element(dull_value* v, size_t index)
         return NULL;
 }
 
+const dull_value* dull_get_array_element_const(const dull_value* v, size_t index)
+{
+    assert(v != NULL && v->type == DULL_ARRAY);
+    return index < v->u.a.size ? v->u.a.e + index : NULL;
+}
+
+static int dull_equal_member(const dull_member* m, const dull_member* n)
+{
+    return m->klen == n->klen && memcmp(m->k, n->k, m->klen) == 0 && dull_equal(&m->v, &n->v);
+}
+
+/* orders members by key, repeated keys by where they appear */
+static int dull_member_order(const void* a, const void* b)
+{
+    const dull_member* m = *(const dull_member* const*)a;
+    const dull_member* n = *(const dull_member* const*)b;
+    int c = memcmp(m->k, n->k, m->klen < n->klen ? m->klen : n->klen);
+    if (c != 0)
+        return c;
+    if (m->klen != n->klen)
+        return m->klen < n->klen ? -1 : 1;
+    return m < n ? -1 : m > n;
+}
+
+int dull_equal(const dull_value* lhs, const dull_value* rhs)
+{
+    size_t i, j, n;
+    const dull_member** sorted;
+    int eq;
+    assert(lhs != NULL && rhs != NULL);
+    if (lhs->type != rhs->type)
+        return 0;
+    switch (lhs->type)
+    {
+    case DULL_NUMBER:
+        return lhs->u.n == rhs->u.n;
+    case DULL_STRING:
+        return lhs->u.s.len == rhs->u.s.len && memcmp(lhs->u.s.s, rhs->u.s.s, lhs->u.s.len) == 0;
+    case DULL_ARRAY:
+        if (lhs->u.a.size != rhs->u.a.size)
+            return 0;
+        for (i = 0; i < lhs->u.a.size; i++)
+            if (!dull_equal(&lhs->u.a.e[i], &rhs->u.a.e[i]))
+                return 0;
+        return 1;
+    case DULL_OBJECT:
+        if (lhs->u.o.size != rhs->u.o.size)
+            return 0;
+        /* members usually line up, only sort the rest when they don't */
+        for (i = 0; i < lhs->u.o.size; i++)
+            if (!dull_equal_member(&lhs->u.o.m[i], &rhs->u.o.m[i]))
+                break;
+        if (i == lhs->u.o.size)
+            return 1;
+        /* both sides sorted by key and occurrence pair off the n-th "a" with the n-th "a" */
+        n = lhs->u.o.size - i;
+        sorted = (const dull_member**)malloc(2 * n * sizeof(const dull_member*));
+        for (j = 0; j < n; j++) {
+            sorted[j] = &lhs->u.o.m[i + j];
+            sorted[n + j] = &rhs->u.o.m[i + j];
+        }
+        qsort(sorted, n, sizeof(const dull_member*), dull_member_order);
+        qsort(sorted + n, n, sizeof(const dull_member*), dull_member_order);
+        for (eq = 1, j = 0; eq && j < n; j++)
+            eq = dull_equal_member(sorted[j], sorted[n + j]);
+        free(sorted);
+        return eq;
+    default:
+        return 1;
+    }
+}
+
+static size_t dull_hash_mix(unsigned long long h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb93fe1a85ec3ULL;
+    h ^= h >> 33;
+    return (size_t)h;
+}
+
+static unsigned long long dull_hash_bytes(const char* s, size_t len, unsigned long long h)
+{
+    size_t i;
+    for (i = 0; i < len; i++) {
+        h ^= (unsigned char)s[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static unsigned long long dull_hash_number(double n)
+{
+    unsigned long long bits;
+    if (n == 0)
+        n = 0; /* -0 equals 0, so it has to hash the same */
+    memcpy(&bits, &n, sizeof(bits));
+    return bits;
+}
+
+size_t dull_hash(const dull_value* v)
+{
+    unsigned long long h;
+    size_t i, acc;
+    assert(v != NULL);
+    h = 14695981039346656037ULL ^ ((unsigned long long)v->type << 56);
+    switch (v->type)
+    {
+    case DULL_NUMBER:
+        h ^= dull_hash_number(v->u.n);
+        break;
+    case DULL_STRING:
+        h = dull_hash_bytes(v->u.s.s, v->u.s.len, h);
+        break;
+    case DULL_ARRAY:
+        h ^= v->u.a.size;
+        for (i = 0; i < v->u.a.size; i++) {
+            const dull_value* e = &v->u.a.e[i];
+            /* a run of numbers folds straight into the hash without recursing */
+            h = (h ^ (e->type == DULL_NUMBER ? dull_hash_number(e->u.n) : dull_hash(e))) * 0x100000001b3ULL;
+        }
+        break;
+    case DULL_OBJECT:
+        /* members are summed, so key order doesn't matter */
+        acc = 0;
+        for (i = 0; i < v->u.o.size; i++) {
+            const dull_member* m = &v->u.o.m[i];
+            acc += dull_hash_mix(dull_hash_bytes(m->k, m->klen, 14695981039346656037ULL) ^ dull_hash(&m->v));
+        }
+        h ^= (unsigned long long)acc ^ v->u.o.size;
+        break;
+    default:
+        break;
+    }
+    return dull_hash_mix(h);
+}
+
+/*
+ * gives v storage of its own before it is resized or gains keys it must free.
+ * only v's array and keys are copied, the descendants stay pooled in the block
+ * and v is marked DULL_F_DETACHED so it is never moved away from that block.
+ */
+static void dull_detach(dull_value* v, size_t capacity)
+{
+    size_t i, n, width;
+    char* old = dull_storage(v);
+    char* p;
+    assert(!DULL_OWNS_STORAGE(v) && (v->type == DULL_ARRAY || v->type == DULL_OBJECT));
+    n = v->type == DULL_ARRAY ? v->u.a.size : v->u.o.size;
+    width = v->type == DULL_ARRAY ? sizeof(dull_value) : sizeof(dull_member);
+    assert(capacity >= n);
+    if (v->flags & DULL_F_BLOCK) {
+        /* the root's storage opened the block, which now hangs off its new storage */
+        p = dull_block_alloc(capacity * width);
+        *(char**)(p - DULL_BLOCK_SLOT) = old - DULL_BLOCK_SLOT;
+    }
+    else
+        p = capacity > 0 ? (char*)malloc(capacity * width) : NULL;
+    if (n > 0)
+        memcpy(p, old, n * width);
+    if (v->type == DULL_ARRAY) {
+        v->u.a.e = (dull_value*)p;
+        v->u.a.capacity = capacity;
+    }
+    else {
+        v->u.o.m = (dull_member*)p;
+        v->u.o.capacity = capacity;
+        for (i = 0; i < n; i++) {
+            dull_member* m = &v->u.o.m[i];
+            const char* k = m->k;
+            memcpy(m->k = (char*)malloc(m->klen + 1), k, m->klen + 1);
+        }
+    }
+    v->flags = (v->flags & DULL_F_BLOCK) | DULL_F_DETACHED;
+}
+
+void dull_set_array(dull_value* v, size_t capacity)
+{
+    assert(v != NULL);
+    dull_free(v);
+    v->type = DULL_ARRAY;
+    v->u.a.size = 0;
+    v->u.a.capacity = capacity;
+    v->u.a.e = capacity > 0 ? (dull_value*)malloc(capacity * sizeof(dull_value)) : NULL;
+}
+
+size_t dull_get_array_capacity(const dull_value* v)
+{
+    assert(v != NULL && v->type == DULL_ARRAY);
+    return v->u.a.capacity;
+}
+
+static void dull_resize_array(dull_value* v, size_t capacity)
+{
+    if (!DULL_OWNS_STORAGE(v))
+        dull_detach(v, capacity);
+    else if (v->flags & DULL_F_BLOCK) {
+        v->u.a.e = (dull_value*)dull_block_realloc((char*)v->u.a.e, capacity * sizeof(dull_value));
+        v->u.a.capacity = capacity;
+    }
+    else if (capacity == 0) {
+        free(v->u.a.e);
+        v->u.a.e = NULL;
+        v->u.a.capacity = 0;
+    }
+    else {
+        v->u.a.e = (dull_value*)realloc(v->u.a.e, capacity * sizeof(dull_value));
+        v->u.a.capacity = capacity;
+    }
+}
+
+void dull_reserve_array(dull_value* v, size_t capacity)
+{
+    assert(v != NULL && v->type == DULL_ARRAY);
+    if (v->u.a.capacity < capacity)
+        dull_resize_array(v, capacity);
+}
+
+void dull_shrink_array(dull_value* v)
+{
+    assert(v != NULL && v->type == DULL_ARRAY);
+    if (v->u.a.capacity > v->u.a.size)
+        dull_resize_array(v, v->u.a.size);
+}
+
+void dull_clear_array(dull_value* v)
+{
+    assert(v != NULL && v->type == DULL_ARRAY);
+    dull_remove_array_element(v, 0, v->u.a.size);
+}
+
+dull_value* dull_pushback_array_element(dull_value* v)
+{
+    assert(v != NULL && v->type == DULL_ARRAY);
+    if (v->u.a.size == v->u.a.capacity)
+        dull_resize_array(v, v->u.a.capacity == 0 ? 1 : v->u.a.capacity * 2);
+    DULL_INIT(&v->u.a.e[v->u.a.size]);
+    return &v->u.a.e[v->u.a.size++];
+}
+
+void dull_popback_array_element(dull_value* v)
+{
+    assert(v != NULL && v->type == DULL_ARRAY && v->u.a.size > 0);
+    dull_free(&v->u.a.e[--v->u.a.size]);
+}
+
+dull_value* dull_insert_array_element(dull_value* v, size_t index)
+{
+    assert(v != NULL && v->type == DULL_ARRAY && index <= v->u.a.size);
+    if (v->u.a.size == v->u.a.capacity)
+        dull_resize_array(v, v->u.a.capacity == 0 ? 1 : v->u.a.capacity * 2);
+    memmove(&v->u.a.e[index + 1], &v->u.a.e[index], (v->u.a.size - index) * sizeof(dull_value));
+    DULL_INIT(&v->u.a.e[index]);
+    v->u.a.size++;
+    return &v->u.a.e[index];
+}
+
+void dull_remove_array_element(dull_value* v, size_t index, size_t count)
+{
+    size_t i;
+    assert(v != NULL && v->type == DULL_ARRAY && index + count <= v->u.a.size);
+    for (i = index; i < index + count; i++)
+        dull_free(&v->u.a.e[i]);
+    memmove(&v->u.a.e[index], &v->u.a.e[index + count], (v->u.a.size - index - count) * sizeof(dull_value));
+    v->u.a.size -= count;
+}
+
 int dull_parse(dull_value* v, const char* json)
+{
+    return dull_parse_ex(v, json, NULL);
+}
+
+/* only runs on failure, so the whitespace loop never has to track lines */
+static void dull_locate_error(const char* json, dull_parse_result* r)
+{
+    const char* p;
+    const char* bol = json;
+    r->line = 1;
+    for (p = json; p < json + r->offset; p++)
+        if (*p == '\n') {
+            r->line++;
+            bol = p + 1;
+        }
+    r->column = (size_t)(json + r->offset - bol) + 1;
+}
+
+/* end is where the input stops when it is not NUL terminated, NULL otherwise */
+static int dull_parse_range(dull_value* v, const char* json, const char* end, dull_parse_result* r, dull_parse_stats* stats)
 {
     assert(v != NULL);
 
@@ -478,50 +1036,2047 @@ int dull_parse(dull_value* v, const char* json)
     c.json = json;
     c.stack = NULL;
     c.size = c.top = 0;
+    c.stats = stats;
+    c.depth = 0;
+    STAT_CLOCK(&c, t0);
     DULL_INIT(v);
     dull_parse_whitespace(&c);
     int ret;
     if((ret = dull_parse_value(&c, v)) == DULL_PARSE_OK)
     {
         dull_parse_whitespace(&c);
-        if (*c.json != '\0')
+        if (*c.json != '\0' || (end != NULL && c.json != end))
         {   
-            v->type = DULL_NULL;
+            dull_free(v);
             ret = DULL_PARSE_ROOT_NOT_SINGULAR;
         }
         
     }
     assert(c.top == 0);
     free(c.stack);
+    STAT(&c, dull_st_->total_ns += dull_now_ns() - t0);
 
+    if (r != NULL)
+    {
+        r->code = ret;
+        r->offset = r->line = r->column = 0;
+        if (ret != DULL_PARSE_OK)
+        {
+            r->offset = (size_t)(c.json - json);
+            dull_locate_error(json, r);
+        }
+    }
     return ret;
 }
 
-dull_type dull_get_type(const dull_value* v)
+int dull_parse_ex(dull_value* v, const char* json, dull_parse_result* r)
 {
-    assert(v != NULL);
-    return v->type;
+    return dull_parse_range(v, json, NULL, r, NULL);
 }
 
-size_t dull_get_object_size(const dull_value* v) {
-    assert(v != NULL && v->type == DULL_OBJECT);
-    return v->u.o.size;
+int dull_parse_stats_ex(dull_value* v, const char* json, dull_parse_stats* stats)
+{
+    assert(stats != NULL);
+    memset(stats, 0, sizeof(dull_parse_stats));
+    return dull_parse_range(v, json, NULL, NULL, stats);
 }
 
-const char* dull_get_object_key(const dull_value* v, size_t index) {
-    assert(v != NULL && v->type == DULL_OBJECT);
-    assert(index < v->u.o.size);
-    return v->u.o.m[index].k;
+/*
+ * the resumable parser keeps what dull_parse_value() keeps on the C stack in
+ * frames: one per open array or object. finished children wait on the value
+ * stack exactly as in dull_parse_array() and dull_parse_obj(), and a member
+ * is pushed as soon as its key is read so its value can be filled in later.
+ */
+enum {
+    DULL_ASYNC_VALUE,  /* a value comes next */
+    DULL_ASYNC_KEY,    /* a key comes next */
+    DULL_ASYNC_AFTER   /* a comma or the closing bracket comes next */
+};
+
+typedef struct
+{
+    char close;
+    size_t size;
+} dull_async_frame;
+
+struct dull_async_parser
+{
+    dull_context c;
+    const char* json;
+    dull_value* v;
+    dull_async_frame* frames;
+    size_t depth, capacity;
+    int state, ret;
+};
+
+dull_async_parser* dull_async_parse_begin(dull_value* v, const char* json)
+{
+    dull_async_parser* p;
+    assert(v != NULL && json != NULL);
+    p = (dull_async_parser*)malloc(sizeof(dull_async_parser));
+    dull_reader_init(&p->c, json);
+    p->json = json;
+    p->v = v;
+    p->frames = NULL;
+    p->depth = p->capacity = 0;
+    p->state = DULL_ASYNC_VALUE;
+    p->ret = DULL_PARSE_PENDING;
+    DULL_INIT(v);
+    dull_parse_whitespace(&p->c);
+    return p;
 }
 
-size_t dull_get_object_key_length(const dull_value* v, size_t index) {
-    assert(v != NULL && v->type == DULL_OBJECT);
-    assert(index < v->u.o.size);
-    return v->u.o.m[index].klen;
+/* pops the children of the innermost frame into their array or object */
+static void dull_async_close(dull_async_parser* p, dull_value* v)
+{
+    dull_async_frame* f = &p->frames[--p->depth];
+    size_t len;
+    if (f->close == ']') {
+        len = f->size * sizeof(dull_value);
+        v->type = DULL_ARRAY;
+        v->u.a.e = len ? (dull_value*)memcpy(malloc(len), dull_context_pop(&p->c, len), len) : NULL;
+        v->u.a.size = v->u.a.capacity = f->size;
+    }
+    else {
+        len = f->size * sizeof(dull_member);
+        v->type = DULL_OBJECT;
+        v->u.o.m = len ? (dull_member*)memcpy(malloc(len), dull_context_pop(&p->c, len), len) : NULL;
+        v->u.o.size = v->u.o.capacity = f->size;
+    }
 }
 
-dull_value* dull_get_object_value(const dull_value* v, size_t index) {
-    assert(v != NULL && v->type == DULL_OBJECT);
-    assert(index < v->u.o.size);
-    return &v->u.o.m[index].v;
-}
\ No newline at end of file
+/* hands a finished value to its container, or finishes the whole parse */
+static void dull_async_complete(dull_async_parser* p, dull_value* v)
+{
+    dull_async_frame* f;
+    p->state = DULL_ASYNC_AFTER;
+    if (p->depth == 0) {
+        memcpy(p->v, v, sizeof(dull_value));
+        dull_parse_whitespace(&p->c);
+        if (*p->c.json != '\0') {
+            dull_free(p->v);
+            p->ret = DULL_PARSE_ROOT_NOT_SINGULAR;
+        }
+        else
+            p->ret = DULL_PARSE_OK;
+        return;
+    }
+    f = &p->frames[p->depth - 1];
+    if (f->close == ']') {
+        memcpy(dull_context_push(&p->c, sizeof(dull_value)), v, sizeof(dull_value));
+        f->size++;
+    }
+    else
+        memcpy(&((dull_member*)(p->c.stack + p->c.top) - 1)->v, v, sizeof(dull_value));
+}
+
+/* one token, or one key with its colon */
+static int dull_async_token(dull_async_parser* p)
+{
+    dull_context* c = &p->c;
+    dull_async_frame* f = p->depth ? &p->frames[p->depth - 1] : NULL;
+    dull_value v;
+    dull_member* m;
+    char* str;
+    char* key;
+    size_t klen;
+    int ret;
+    DULL_INIT(&v);
+    switch (p->state) {
+    case DULL_ASYNC_VALUE:
+        if (*c->json != '[' && *c->json != '{') {
+            if ((ret = dull_parse_value(c, &v)) != DULL_PARSE_OK)
+                return ret;
+            dull_async_complete(p, &v);
+            return DULL_PARSE_OK;
+        }
+        if (p->depth == p->capacity) {
+            p->capacity = p->capacity == 0 ? 8 : p->capacity * 2;
+            p->frames = (dull_async_frame*)realloc(p->frames, p->capacity * sizeof(dull_async_frame));
+        }
+        f = &p->frames[p->depth++];
+        f->close = *c->json++ == '[' ? ']' : '}';
+        f->size = 0;
+        dull_parse_whitespace(c);
+        if (*c->json == f->close) {
+            c->json++;
+            dull_async_close(p, &v);
+            dull_async_complete(p, &v);
+        }
+        else
+            p->state = f->close == '}' ? DULL_ASYNC_KEY : DULL_ASYNC_VALUE;
+        return DULL_PARSE_OK;
+    case DULL_ASYNC_KEY:
+        if (*c->json != '"')
+            return DULL_PARSE_MISS_KEY;
+        if ((ret = dull_parse_string_raw(c, &str, &klen)) != DULL_PARSE_OK)
+            return ret;
+        /* str lies in the popped part of the stack, copy it out before pushing the member */
+        key = (char*)malloc(klen + 1);
+        if (klen)  /* an empty key may come back with str NULL */
+            memcpy(key, str, klen);
+        key[klen] = '\0';
+        m = (dull_member*)dull_context_push(c, sizeof(dull_member));
+        m->k = key;
+        m->klen = klen;
+        DULL_INIT(&m->v);
+        f->size++;
+        dull_parse_whitespace(c);
+        if (*c->json != ':')
+            return DULL_PARSE_MISS_COLON;
+        c->json++;
+        dull_parse_whitespace(c);
+        p->state = DULL_ASYNC_VALUE;
+        return DULL_PARSE_OK;
+    default:
+        dull_parse_whitespace(c);
+        if (*c->json == ',') {
+            c->json++;
+            dull_parse_whitespace(c);
+            p->state = f->close == '}' ? DULL_ASYNC_KEY : DULL_ASYNC_VALUE;
+        }
+        else if (*c->json == f->close) {
+            c->json++;
+            dull_async_close(p, &v);
+            dull_async_complete(p, &v);
+        }
+        else
+            return f->close == ']' ? DULL_PARSE_MISS_COMMA_OR_SQUARE_BRACKET : DULL_PARSE_MISS_COMMA_OR_CURLY_BRACKET;
+        return DULL_PARSE_OK;
+    }
+}
+
+/* frees the children of every open frame, the way the recursive parser's error paths do */
+static void dull_async_unwind(dull_async_parser* p)
+{
+    for (; p->depth > 0; p->depth--) {
+        dull_async_frame* f = &p->frames[p->depth - 1];
+        for (; f->size > 0; f->size--) {
+            if (f->close == ']')
+                dull_free((dull_value*)dull_context_pop(&p->c, sizeof(dull_value)));
+            else {
+                dull_member* m = (dull_member*)dull_context_pop(&p->c, sizeof(dull_member));
+                free(m->k);
+                dull_free(&m->v);
+            }
+        }
+    }
+}
+
+int dull_async_parse_step(dull_async_parser* p, size_t budget)
+{
+    const char* start;
+    int ret;
+    assert(p != NULL);
+    /* a token is never split, so a step always makes progress and may overrun the budget */
+    for (start = p->c.json; p->ret == DULL_PARSE_PENDING; ) {
+        if (p->c.json != start && (size_t)(p->c.json - start) >= budget)
+            break;
+        if ((ret = dull_async_token(p)) != DULL_PARSE_OK) {
+            p->ret = ret;
+            dull_async_unwind(p);
+        }
+    }
+    return p->ret;
+}
+
+int dull_async_parse_end(dull_async_parser* p, dull_parse_result* r)
+{
+    int ret;
+    assert(p != NULL);
+    /* an abandoned parse leaves v null */
+    dull_async_unwind(p);
+    ret = p->ret;
+    if (r != NULL) {
+        r->code = ret;
+        r->offset = r->line = r->column = 0;
+        if (ret != DULL_PARSE_OK) {
+            r->offset = (size_t)(p->c.json - p->json);
+            dull_locate_error(p->json, r);
+        }
+    }
+    assert(p->c.top == 0);
+    dull_reader_free(&p->c);
+    free(p->frames);
+    free(p);
+    return ret;
+}
+
+int dull_parse_file(dull_value* v, const char* path, int flags)
+{
+    return dull_parse_file_ex(v, path, flags, NULL);
+}
+
+/* the file couldn't be read, so there is no position to report */
+static int dull_file_error(dull_parse_result* r)
+{
+    if (r != NULL) {
+        r->code = DULL_PARSE_FILE_ERROR;
+        r->offset = r->line = r->column = 0;
+    }
+    return DULL_PARSE_FILE_ERROR;
+}
+
+#ifdef DULL_HAVE_MMAP
+/* pipes and /proc files report no size up front and can't be mapped, so they are read to the end */
+static int dull_parse_fd_stream(dull_value* v, int fd, dull_parse_result* r)
+{
+    size_t size = 0, capacity = 4096;
+    char* json = (char*)malloc(capacity);
+    ssize_t n;
+    int ret;
+    for (;;) {
+        if (size + 1 == capacity)
+            json = (char*)realloc(json, capacity += capacity >> 1);
+        if ((n = read(fd, json + size, capacity - 1 - size)) > 0)
+            size += (size_t)n;
+        else if (n == 0)
+            break;
+        else if (errno != EINTR) {
+            free(json);
+            close(fd);
+            return dull_file_error(r);
+        }
+    }
+    close(fd);
+    json[size] = '\0';
+    ret = dull_parse_range(v, json, json + size, r, NULL);
+    free(json);
+    return ret;
+}
+
+int dull_parse_file_ex(dull_value* v, const char* path, int flags, dull_parse_result* r)
+{
+    struct stat st;
+    size_t size, map_size, page;
+    char* base;
+    int fd, ret, map_flags = MAP_PRIVATE;
+    assert(v != NULL && path != NULL);
+    DULL_INIT(v);
+    if ((fd = open(path, O_RDONLY)) < 0)
+        return dull_file_error(r);
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return dull_file_error(r);
+    }
+    if (!S_ISREG(st.st_mode))
+        return dull_parse_fd_stream(v, fd, r);
+    size = (size_t)st.st_size;
+    page = (size_t)sysconf(_SC_PAGESIZE);
+    map_size = (size + 1 + page - 1) / page * page;
+
+    /*
+     * the file is mapped over a zeroed anonymous reservation one byte longer,
+     * so a NUL follows the last byte without copying the input
+     */
+    base = (char*)mmap(NULL, map_size, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        close(fd);
+        return dull_file_error(r);
+    }
+#ifdef MAP_POPULATE
+    if (flags & DULL_FILE_POPULATE)
+        map_flags |= MAP_POPULATE;
+#endif
+    if (size > 0 && mmap(base, size, PROT_READ, map_flags | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        munmap(base, map_size);
+        close(fd);
+        return dull_file_error(r);
+    }
+    close(fd);
+
+    posix_madvise(base, map_size, POSIX_MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+    if (flags & DULL_FILE_HUGEPAGE)
+        madvise(base, map_size, MADV_HUGEPAGE);
+#endif
+
+    ret = dull_parse_range(v, base, base + size, r, NULL);
+    munmap(base, map_size);
+    return ret;
+}
+#else
+int dull_parse_file_ex(dull_value* v, const char* path, int flags, dull_parse_result* r)
+{
+    FILE* fp;
+    char* json;
+    long size;
+    int ret;
+    assert(v != NULL && path != NULL);
+    (void)flags;
+    DULL_INIT(v);
+    if ((fp = fopen(path, "rb")) == NULL)
+        return dull_file_error(r);
+    if (fseek(fp, 0, SEEK_END) != 0 || (size = ftell(fp)) < 0 || fseek(fp, 0, SEEK_SET) != 0) {
+        fclose(fp);
+        return dull_file_error(r);
+    }
+    json = (char*)malloc((size_t)size + 1);
+    if (fread(json, 1, (size_t)size, fp) != (size_t)size) {
+        free(json);
+        fclose(fp);
+        return dull_file_error(r);
+    }
+    fclose(fp);
+    json[size] = '\0';
+    ret = dull_parse_range(v, json, json + size, r, NULL);
+    free(json);
+    return ret;
+}
+#endif
+
+#define DULL_SNAPSHOT_MAGIC "DULLSNAP"
+#define DULL_SNAPSHOT_VERSION 1
+
+/*
+ * a snapshot is this header followed by the block dull_copy() would build,
+ * with every pointer stored as an offset from the start of the block
+ */
+typedef struct
+{
+    char magic[8];
+    unsigned version;
+    unsigned value_size;  /* rejects snapshots from a different struct layout */
+    size_t block_size;
+    dull_value root;
+} dull_snapshot_header;
+
+#define DULL_OFFSET(p, base) ((char*)(size_t)((char*)(p) - (base)))
+
+static void dull_snapshot_unfix(dull_value* v, char* base)
+{
+    size_t i;
+    switch (v->type)
+    {
+    case DULL_STRING:
+        v->u.s.s = DULL_OFFSET(v->u.s.s, base);
+        break;
+    case DULL_ARRAY:
+        for (i = 0; i < v->u.a.size; i++)
+            dull_snapshot_unfix(&v->u.a.e[i], base);
+        if (v->u.a.size > 0)
+            v->u.a.e = (dull_value*)DULL_OFFSET(v->u.a.e, base);
+        break;
+    case DULL_OBJECT:
+        for (i = 0; i < v->u.o.size; i++) {
+            dull_snapshot_unfix(&v->u.o.m[i].v, base);
+            v->u.o.m[i].k = DULL_OFFSET(v->u.o.m[i].k, base);
+        }
+        if (v->u.o.size > 0)
+            v->u.o.m = (dull_member*)DULL_OFFSET(v->u.o.m, base);
+        break;
+    default:
+        break;
+    }
+    v->flags = 0;
+}
+
+int dull_save_snapshot(const dull_value* v, const char* path)
+{
+    dull_snapshot_header h;
+    FILE* fp;
+    char* base;
+    int ret = 0;
+    assert(v != NULL && path != NULL);
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, DULL_SNAPSHOT_MAGIC, sizeof(h.magic));
+    h.version = DULL_SNAPSHOT_VERSION;
+    h.value_size = sizeof(dull_value);
+    h.block_size = dull_subtree_size(v);
+    DULL_INIT(&h.root);
+    dull_copy(&h.root, v);
+    /* the copy's block starts with the root's own storage */
+    base = h.block_size > 0 ? dull_storage(&h.root) : NULL;
+    if (base != NULL)
+        dull_snapshot_unfix(&h.root, base);
+    if ((fp = fopen(path, "wb")) == NULL)
+        ret = -1;
+    else {
+        if (fwrite(&h, sizeof(h), 1, fp) != 1 ||
+            (h.block_size > 0 && fwrite(base, h.block_size, 1, fp) != 1))
+            ret = -1;
+        if (fclose(fp) != 0)
+            ret = -1;
+    }
+    if (base != NULL)
+        dull_block_free(base);
+    return ret;
+}
+
+/* turns offsets back into pointers; storage must lie in [*next, size) so a bad file can't loop */
+static int dull_snapshot_fix(dull_value* v, char* base, size_t size, size_t* next, unsigned flags)
+{
+    size_t i, off, len;
+    v->flags = flags;
+    switch (v->type)
+    {
+    case DULL_NULL:
+    case DULL_FALSE:
+    case DULL_TRUE:
+    case DULL_NUMBER:
+        v->flags = 0;
+        return DULL_PARSE_OK;
+    case DULL_STRING:
+        off = (size_t)v->u.s.s;
+        len = v->u.s.len;
+        if (off < *next || off > size || DULL_ALIGN(off) != off || len >= size - off || base[off + len] != '\0')
+            return DULL_PARSE_INVALID_SNAPSHOT;
+        v->u.s.s = base + off;
+        *next = off + DULL_ALIGN(len + 1);
+        return DULL_PARSE_OK;
+    case DULL_ARRAY:
+        v->u.a.capacity = v->u.a.size;
+        if (v->u.a.size == 0) {
+            v->u.a.e = NULL;
+            v->flags = 0;
+            return DULL_PARSE_OK;
+        }
+        off = (size_t)v->u.a.e;
+        if (off < *next || off > size || DULL_ALIGN(off) != off || v->u.a.size > (size - off) / sizeof(dull_value))
+            return DULL_PARSE_INVALID_SNAPSHOT;
+        v->u.a.e = (dull_value*)(base + off);
+        *next = off + v->u.a.size * sizeof(dull_value);
+        for (i = 0; i < v->u.a.size; i++)
+            if (dull_snapshot_fix(&v->u.a.e[i], base, size, next, DULL_F_POOLED) != DULL_PARSE_OK)
+                return DULL_PARSE_INVALID_SNAPSHOT;
+        return DULL_PARSE_OK;
+    case DULL_OBJECT:
+        v->u.o.capacity = v->u.o.size;
+        if (v->u.o.size == 0) {
+            v->u.o.m = NULL;
+            v->flags = 0;
+            return DULL_PARSE_OK;
+        }
+        off = (size_t)v->u.o.m;
+        if (off < *next || off > size || DULL_ALIGN(off) != off || v->u.o.size > (size - off) / sizeof(dull_member))
+            return DULL_PARSE_INVALID_SNAPSHOT;
+        v->u.o.m = (dull_member*)(base + off);
+        *next = off + v->u.o.size * sizeof(dull_member);
+        for (i = 0; i < v->u.o.size; i++) {
+            dull_member* m = &v->u.o.m[i];
+            off = (size_t)m->k;
+            if (off < *next || off > size || DULL_ALIGN(off) != off || m->klen >= size - off || base[off + m->klen] != '\0')
+                return DULL_PARSE_INVALID_SNAPSHOT;
+            m->k = base + off;
+            *next = off + DULL_ALIGN(m->klen + 1);
+            if (dull_snapshot_fix(&m->v, base, size, next, DULL_F_POOLED) != DULL_PARSE_OK)
+                return DULL_PARSE_INVALID_SNAPSHOT;
+        }
+        return DULL_PARSE_OK;
+    default:
+        return DULL_PARSE_INVALID_SNAPSHOT;
+    }
+}
+
+int dull_load_snapshot(dull_value* v, const char* path)
+{
+    dull_snapshot_header h;
+    FILE* fp;
+    char* base = NULL;
+    size_t next = 0;
+    int ret = DULL_PARSE_OK;
+    assert(v != NULL && path != NULL);
+    DULL_INIT(v);
+    if ((fp = fopen(path, "rb")) == NULL)
+        return DULL_PARSE_FILE_ERROR;
+    if (fread(&h, sizeof(h), 1, fp) != 1)
+        ret = DULL_PARSE_FILE_ERROR;
+    else if (memcmp(h.magic, DULL_SNAPSHOT_MAGIC, sizeof(h.magic)) != 0 ||
+        h.version != DULL_SNAPSHOT_VERSION || h.value_size != sizeof(dull_value))
+        ret = DULL_PARSE_INVALID_SNAPSHOT;
+    else if (fseek(fp, 0, SEEK_END) != 0 || ftell(fp) < 0 ||
+        (size_t)ftell(fp) - sizeof(h) != h.block_size || fseek(fp, sizeof(h), SEEK_SET) != 0)
+        ret = DULL_PARSE_INVALID_SNAPSHOT;
+    else if (h.block_size > 0 &&
+        ((base = dull_block_alloc(h.block_size)) == NULL || fread(base, h.block_size, 1, fp) != 1))
+        ret = DULL_PARSE_FILE_ERROR;
+    fclose(fp);
+    /* the root's storage has to open the block for dull_free() to release it */
+    if (ret == DULL_PARSE_OK &&
+        (dull_snapshot_fix(&h.root, base, h.block_size, &next, DULL_F_BLOCK) != DULL_PARSE_OK ||
+        next != h.block_size || (base != NULL && dull_storage(&h.root) != base)))
+        ret = DULL_PARSE_INVALID_SNAPSHOT;
+    if (ret != DULL_PARSE_OK) {
+        if (base != NULL)
+            dull_block_free(base);
+        return ret;
+    }
+    memcpy(v, &h.root, sizeof(dull_value));
+    return DULL_PARSE_OK;
+}
+
+void dull_reader_init(dull_reader* r, const char* json)
+{
+    assert(r != NULL && json != NULL);
+    r->json = json;
+    r->stack = NULL;
+    r->size = r->top = 0;
+    r->stats = NULL;
+    r->depth = 0;
+}
+
+void dull_reader_free(dull_reader* r)
+{
+    assert(r != NULL);
+    free(r->stack);
+    r->stack = NULL;
+    r->size = r->top = 0;
+}
+
+char dull_reader_peek(dull_reader* r)
+{
+    assert(r != NULL);
+    dull_parse_whitespace(r);
+    return *r->json;
+}
+
+int dull_reader_number(dull_reader* r, double* n)
+{
+    dull_value v;
+    int ret;
+    assert(r != NULL && n != NULL);
+    dull_parse_whitespace(r);
+    if (*r->json == '\0')
+        return DULL_PARSE_EXPECT_VALUE;
+    if (!(*r->json == '-' || ISDIGIT(*r->json)))
+        return DULL_PARSE_TYPE_MISMATCH;
+    if ((ret = dull_parse_number(r, &v)) == DULL_PARSE_OK)
+        *n = v.u.n;
+    return ret;
+}
+
+int dull_reader_boolean(dull_reader* r, int* b)
+{
+    dull_value v;
+    int ret;
+    assert(r != NULL && b != NULL);
+    switch (dull_reader_peek(r))
+    {
+        case 't': ret = dull_parse_literal(r, &v, "true", DULL_TRUE); break;
+        case 'f': ret = dull_parse_literal(r, &v, "false", DULL_FALSE); break;
+        case '\0': return DULL_PARSE_EXPECT_VALUE;
+        default: return DULL_PARSE_TYPE_MISMATCH;
+    }
+    if (ret == DULL_PARSE_OK)
+        *b = v.type == DULL_TRUE;
+    return ret;
+}
+
+int dull_reader_string(dull_reader* r, const char** s, size_t* len)
+{
+    char* str;
+    int ret;
+    assert(r != NULL && s != NULL && len != NULL);
+    switch (dull_reader_peek(r))
+    {
+        case '"': break;
+        case '\0': return DULL_PARSE_EXPECT_VALUE;
+        default: return DULL_PARSE_TYPE_MISMATCH;
+    }
+    /* the bytes stay in the popped part of the stack until the next push */
+    if ((ret = dull_parse_string_raw(r, &str, len)) == DULL_PARSE_OK)
+        *s = *len > 0 ? str : "";
+    return ret;
+}
+
+/* validates one value like dull_parse_value() but keeps nothing */
+static int dull_skip_value(dull_context* c)
+{
+    dull_value v;
+    char* str;
+    size_t len;
+    int ret;
+    char close = *c->json == '[' ? ']' : '}';
+    switch (*c->json)
+    {
+        case 'n': return dull_parse_literal(c, &v, "null", DULL_NULL);
+        case 't': return dull_parse_literal(c, &v, "true", DULL_TRUE);
+        case 'f': return dull_parse_literal(c, &v, "false", DULL_FALSE);
+        case '"': return dull_parse_string_raw(c, &str, &len);
+        case '[':
+        case '{':
+            c->json++;
+            dull_parse_whitespace(c);
+            if (*c->json == close) {
+                c->json++;
+                return DULL_PARSE_OK;
+            }
+            for (;;) {
+                if (close == '}') {
+                    if (*c->json != '"')
+                        return DULL_PARSE_MISS_KEY;
+                    if ((ret = dull_parse_string_raw(c, &str, &len)) != DULL_PARSE_OK)
+                        return ret;
+                    dull_parse_whitespace(c);
+                    if (*c->json != ':')
+                        return DULL_PARSE_MISS_COLON;
+                    c->json++;
+                    dull_parse_whitespace(c);
+                }
+                if ((ret = dull_skip_value(c)) != DULL_PARSE_OK)
+                    return ret;
+                dull_parse_whitespace(c);
+                if (*c->json == close) {
+                    c->json++;
+                    return DULL_PARSE_OK;
+                }
+                if (*c->json != ',')
+                    return close == ']' ? DULL_PARSE_MISS_COMMA_OR_SQUARE_BRACKET : DULL_PARSE_MISS_COMMA_OR_CURLY_BRACKET;
+                c->json++;
+                dull_parse_whitespace(c);
+            }
+        case '\0': return DULL_PARSE_EXPECT_VALUE;
+        default: return dull_parse_number(c, &v);
+    }
+}
+
+int dull_reader_skip(dull_reader* r)
+{
+    assert(r != NULL);
+    dull_parse_whitespace(r);
+    return dull_skip_value(r);
+}
+
+dull_type dull_get_type(const dull_value* v)
+{
+    assert(v != NULL);
+    return v->type;
+}
+
+size_t dull_get_object_size(const dull_value* v) {
+    assert(v != NULL && v->type == DULL_OBJECT);
+    return v->u.o.size;
+}
+
+const char* dull_get_object_key(const dull_value* v, size_t index) {
+    assert(v != NULL && v->type == DULL_OBJECT);
+    assert(index < v->u.o.size);
+    return v->u.o.m[index].k;
+}
+
+size_t dull_get_object_key_length(const dull_value* v, size_t index) {
+    assert(v != NULL && v->type == DULL_OBJECT);
+    assert(index < v->u.o.size);
+    return v->u.o.m[index].klen;
+}
+
+dull_value* dull_get_object_value(const dull_value* v, size_t index) {
+    assert(v != NULL && v->type == DULL_OBJECT);
+    assert(index < v->u.o.size);
+    return &v->u.o.m[index].v;
+}
+
+void dull_set_object(dull_value* v, size_t capacity)
+{
+    assert(v != NULL);
+    dull_free(v);
+    v->type = DULL_OBJECT;
+    v->u.o.size = 0;
+    v->u.o.capacity = capacity;
+    v->u.o.m = capacity > 0 ? (dull_member*)malloc(capacity * sizeof(dull_member)) : NULL;
+}
+
+size_t dull_get_object_capacity(const dull_value* v)
+{
+    assert(v != NULL && v->type == DULL_OBJECT);
+    return v->u.o.capacity;
+}
+
+static void dull_resize_object(dull_value* v, size_t capacity)
+{
+    if (!DULL_OWNS_STORAGE(v))
+        dull_detach(v, capacity);
+    else if (v->flags & DULL_F_BLOCK) {
+        v->u.o.m = (dull_member*)dull_block_realloc((char*)v->u.o.m, capacity * sizeof(dull_member));
+        v->u.o.capacity = capacity;
+    }
+    else if (capacity == 0) {
+        free(v->u.o.m);
+        v->u.o.m = NULL;
+        v->u.o.capacity = 0;
+    }
+    else {
+        v->u.o.m = (dull_member*)realloc(v->u.o.m, capacity * sizeof(dull_member));
+        v->u.o.capacity = capacity;
+    }
+}
+
+void dull_reserve_object(dull_value* v, size_t capacity)
+{
+    assert(v != NULL && v->type == DULL_OBJECT);
+    if (v->u.o.capacity < capacity)
+        dull_resize_object(v, capacity);
+}
+
+void dull_shrink_object(dull_value* v)
+{
+    assert(v != NULL && v->type == DULL_OBJECT);
+    if (v->u.o.capacity > v->u.o.size)
+        dull_resize_object(v, v->u.o.size);
+}
+
+void dull_clear_object(dull_value* v)
+{
+    assert(v != NULL && v->type == DULL_OBJECT);
+    while (v->u.o.size > 0)
+        dull_remove_object_value(v, v->u.o.size - 1);
+}
+
+size_t dull_find_object_index(const dull_value* v, const char* key, size_t klen)
+{
+    size_t i;
+    assert(v != NULL && v->type == DULL_OBJECT && key != NULL);
+    for (i = 0; i < v->u.o.size; i++)
+        if (v->u.o.m[i].klen == klen && memcmp(v->u.o.m[i].k, key, klen) == 0)
+            return i;
+    return DULL_KEY_NOT_EXIST;
+}
+
+dull_value* dull_find_object_value(dull_value* v, const char* key, size_t klen)
+{
+    size_t index = dull_find_object_index(v, key, klen);
+    return index != DULL_KEY_NOT_EXIST ? &v->u.o.m[index].v : NULL;
+}
+
+const dull_value* dull_find_object_value_const(const dull_value* v, const char* key, size_t klen)
+{
+    size_t index = dull_find_object_index(v, key, klen);
+    return index != DULL_KEY_NOT_EXIST ? &v->u.o.m[index].v : NULL;
+}
+
+/* adds a member at the end even if the key is already there */
+static dull_value* dull_append_object_member(dull_value* v, const char* key, size_t klen)
+{
+    dull_member* m;
+    if (v->u.o.size == v->u.o.capacity)
+        dull_resize_object(v, v->u.o.capacity == 0 ? 1 : v->u.o.capacity * 2);
+    else if (!DULL_OWNS_STORAGE(v))
+        /* pooled keys can't be mixed with keys that are freed one by one */
+        dull_resize_object(v, v->u.o.capacity);
+    m = &v->u.o.m[v->u.o.size++];
+    memcpy(m->k = (char*)malloc(klen + 1), key, klen);
+    m->k[klen] = '\0';
+    m->klen = klen;
+    DULL_INIT(&m->v);
+    return &m->v;
+}
+
+dull_value* dull_set_object_value(dull_value* v, const char* key, size_t klen)
+{
+    dull_value* found;
+    assert(v != NULL && v->type == DULL_OBJECT && key != NULL);
+    if ((found = dull_find_object_value(v, key, klen)) != NULL)
+        return found;
+    return dull_append_object_member(v, key, klen);
+}
+
+void dull_remove_object_value(dull_value* v, size_t index)
+{
+    assert(v != NULL && v->type == DULL_OBJECT && index < v->u.o.size);
+    if (DULL_OWNS_STORAGE(v))
+        free(v->u.o.m[index].k);
+    dull_free(&v->u.o.m[index].v);
+    memmove(&v->u.o.m[index], &v->u.o.m[index + 1], (v->u.o.size - index - 1) * sizeof(dull_member));
+    v->u.o.size--;
+}
+
+/* one step of rollback for dull_apply_patch(), recorded as each change is made */
+enum {
+    DULL_UNDO_REMOVE,   /* a value was inserted at index */
+    DULL_UNDO_INSERT,   /* the value at index was removed, saved holds it */
+    DULL_UNDO_REPLACE   /* the value at index was overwritten, saved holds the old one */
+};
+
+typedef struct
+{
+    int kind;
+    int carry;           /* DULL_UNDO_INSERT takes the value the next undo step took out */
+    const char* parent;  /* JSON pointer of the container, NULL for the root itself */
+    size_t plen, index;
+    char* key;           /* key of a removed member */
+    size_t klen;
+    dull_value saved;
+} dull_undo;
+
+static dull_value* dull_child(dull_value* v, size_t index)
+{
+    return v->type == DULL_ARRAY ? &v->u.a.e[index] : &v->u.o.m[index].v;
+}
+
+/* compares a key with a reference token, where "~0" stands for '~' and "~1" for '/' */
+static int dull_pointer_match(const char* k, size_t klen, const char* tok, size_t tlen)
+{
+    const char* end = tok + tlen;
+    for (; tok < end; tok++, k++, klen--) {
+        char ch = *tok;
+        if (ch == '~') {
+            if (++tok == end || (*tok != '0' && *tok != '1'))
+                return 0;
+            ch = *tok == '0' ? '~' : '/';
+        }
+        if (klen == 0 || *k != ch)
+            return 0;
+    }
+    return klen == 0;
+}
+
+/* index of the child named by tok, "-" is the end of an array when allowed */
+static size_t dull_pointer_find(const dull_value* v, const char* tok, size_t tlen, int allow_end)
+{
+    size_t i, index = 0;
+    if (v->type == DULL_OBJECT) {
+        for (i = 0; i < v->u.o.size; i++)
+            if (dull_pointer_match(v->u.o.m[i].k, v->u.o.m[i].klen, tok, tlen))
+                return i;
+        return DULL_KEY_NOT_EXIST;
+    }
+    if (v->type != DULL_ARRAY || tlen == 0)
+        return DULL_KEY_NOT_EXIST;
+    if (tlen == 1 && *tok == '-')
+        return allow_end ? v->u.a.size : DULL_KEY_NOT_EXIST;
+    if (tlen > 1 && *tok == '0')
+        return DULL_KEY_NOT_EXIST;
+    for (i = 0; i < tlen; i++) {
+        if (!ISDIGIT(tok[i]) || index > (v->u.a.size - (tok[i] - '0')) / 10)
+            return DULL_KEY_NOT_EXIST;
+        index = index * 10 + (tok[i] - '0');
+    }
+    return index < v->u.a.size || (allow_end && index == v->u.a.size) ? index : DULL_KEY_NOT_EXIST;
+}
+
+static dull_value* dull_pointer_get(dull_value* v, const char* p, size_t len)
+{
+    const char* end = p + len;
+    while (p < end) {
+        const char* tok;
+        size_t index;
+        if (*p != '/')
+            return NULL;
+        for (tok = ++p; p < end && *p != '/'; p++);
+        if ((index = dull_pointer_find(v, tok, p - tok, 0)) == DULL_KEY_NOT_EXIST)
+            return NULL;
+        v = dull_child(v, index);
+    }
+    return v;
+}
+
+/* a pointer is empty or starts with '/', and '~' is always followed by '0' or '1' */
+static int dull_pointer_valid(const dull_value* path)
+{
+    const char* p = path->u.s.s;
+    const char* end = p + path->u.s.len;
+    if (p < end && *p != '/')
+        return 0;
+    for (; p < end; p++)
+        if (*p == '~' && (++p == end || (*p != '0' && *p != '1')))
+            return 0;
+    return 1;
+}
+
+/* resolves all but the last token of path, leaving parent NULL for the root */
+static int dull_pointer_parent(dull_value* root, const dull_value* path, dull_value** parent, const char** tok, size_t* tlen)
+{
+    const char* p = path->u.s.s;
+    const char* last = p + path->u.s.len;
+    *parent = NULL;
+    if (path->u.s.len == 0)
+        return DULL_PATCH_OK;
+    while (*--last != '/');
+    *parent = dull_pointer_get(root, p, last - p);
+    if (*parent == NULL || ((*parent)->type != DULL_ARRAY && (*parent)->type != DULL_OBJECT))
+        return DULL_PATCH_PATH_NOT_FOUND;
+    *tok = last + 1;
+    *tlen = p + path->u.s.len - *tok;
+    return DULL_PATCH_OK;
+}
+
+/* puts a member back where it was, next to any others with the same key */
+static dull_value* dull_insert_object_member(dull_value* v, size_t index, const char* key, size_t klen)
+{
+    dull_member m;
+    dull_append_object_member(v, key, klen);
+    m = v->u.o.m[v->u.o.size - 1];
+    memmove(&v->u.o.m[index + 1], &v->u.o.m[index], (v->u.o.size - 1 - index) * sizeof(dull_member));
+    v->u.o.m[index] = m;
+    return &v->u.o.m[index].v;
+}
+
+/* moves value to path, either as a new element or member or over the old one */
+static int dull_patch_add(dull_value* root, const dull_value* path, int replace, dull_value* value, dull_undo* e)
+{
+    dull_value* parent;
+    dull_value* slot;
+    const char* tok;
+    size_t tlen, i;
+    int ret;
+    if ((ret = dull_pointer_parent(root, path, &parent, &tok, &tlen)) != DULL_PATCH_OK)
+        return ret;
+    e->parent = parent ? path->u.s.s : NULL;
+    e->plen = parent ? tok - 1 - path->u.s.s : 0;
+    if (parent == NULL)
+        slot = root;
+    else if ((i = dull_pointer_find(parent, tok, tlen, !replace)) != DULL_KEY_NOT_EXIST) {
+        e->index = i;
+        if (parent->type == DULL_ARRAY && !replace) {
+            e->kind = DULL_UNDO_REMOVE;
+            dull_move(dull_insert_array_element(parent, i), value);
+            return DULL_PATCH_OK;
+        }
+        slot = dull_child(parent, i);
+    }
+    else if (parent->type == DULL_OBJECT && !replace) {
+        char* key = (char*)malloc(tlen + 1);
+        size_t klen = 0;
+        for (i = 0; i < tlen; i++)
+            key[klen++] = tok[i] == '~' ? (tok[++i] == '0' ? '~' : '/') : tok[i];
+        e->kind = DULL_UNDO_REMOVE;
+        e->index = parent->u.o.size;
+        dull_move(dull_set_object_value(parent, key, klen), value);
+        free(key);
+        return DULL_PATCH_OK;
+    }
+    else
+        return DULL_PATCH_PATH_NOT_FOUND;
+    e->kind = DULL_UNDO_REPLACE;
+    dull_move(&e->saved, slot);
+    dull_move(slot, value);
+    return DULL_PATCH_OK;
+}
+
+/* takes the value at path out of its container into out */
+static int dull_patch_take(dull_value* root, const dull_value* path, dull_value* out, dull_undo* e)
+{
+    dull_value* parent;
+    const char* tok;
+    size_t tlen, i;
+    int ret;
+    if ((ret = dull_pointer_parent(root, path, &parent, &tok, &tlen)) != DULL_PATCH_OK)
+        return ret;
+    if (parent == NULL || (i = dull_pointer_find(parent, tok, tlen, 0)) == DULL_KEY_NOT_EXIST)
+        return DULL_PATCH_PATH_NOT_FOUND;
+    e->kind = DULL_UNDO_INSERT;
+    e->parent = path->u.s.s;
+    e->plen = tok - 1 - path->u.s.s;
+    e->index = i;
+    dull_move(out, dull_child(parent, i));
+    if (parent->type == DULL_ARRAY)
+        dull_remove_array_element(parent, i, 1);
+    else {
+        dull_member* m = &parent->u.o.m[i];
+        memcpy(e->key = (char*)malloc(m->klen + 1), m->k, m->klen + 1);
+        e->klen = m->klen;
+        dull_remove_object_value(parent, i);
+    }
+    return DULL_PATCH_OK;
+}
+
+/* replays the log backwards, every step sees the tree exactly as its change left it */
+static void dull_patch_undo(dull_value* root, dull_undo* log, size_t n)
+{
+    dull_value carry;
+    DULL_INIT(&carry);
+    while (n-- > 0) {
+        dull_undo* e = &log[n];
+        dull_value* parent = e->parent ? dull_pointer_get(root, e->parent, e->plen) : NULL;
+        dull_value* slot;
+        switch (e->kind) {
+        case DULL_UNDO_REMOVE:
+            dull_move(&carry, dull_child(parent, e->index));
+            if (parent->type == DULL_ARRAY)
+                dull_remove_array_element(parent, e->index, 1);
+            else
+                dull_remove_object_value(parent, e->index);
+            break;
+        case DULL_UNDO_INSERT:
+            slot = parent->type == DULL_ARRAY ? dull_insert_array_element(parent, e->index)
+                : dull_insert_object_member(parent, e->index, e->key, e->klen);
+            dull_move(slot, e->carry ? &carry : &e->saved);
+            break;
+        default:
+            slot = parent ? dull_child(parent, e->index) : root;
+            dull_move(&carry, slot);
+            dull_move(slot, &e->saved);
+        }
+    }
+    dull_free(&carry);
+}
+
+static const dull_value* dull_patch_member(const dull_value* op, const char* key, dull_type type)
+{
+    size_t i = dull_find_object_index(op, key, strlen(key));
+    if (i == DULL_KEY_NOT_EXIST || (type != DULL_NULL && op->u.o.m[i].v.type != type))
+        return NULL;
+    return &op->u.o.m[i].v;
+}
+
+static int dull_patch_op(dull_value* root, const dull_value* op, dull_undo* log, size_t* n)
+{
+    const dull_value* name;
+    const dull_value* path;
+    const dull_value* from = NULL;
+    const dull_value* value = NULL;
+    dull_value tmp;
+    int ret = DULL_PATCH_INVALID_OPERATION;
+    if (op->type != DULL_OBJECT ||
+        (name = dull_patch_member(op, "op", DULL_STRING)) == NULL ||
+        (path = dull_patch_member(op, "path", DULL_STRING)) == NULL || !dull_pointer_valid(path))
+        return DULL_PATCH_INVALID_OPERATION;
+#define DULL_OP_IS(lit) (name->u.s.len == sizeof(lit) - 1 && memcmp(name->u.s.s, lit, sizeof(lit) - 1) == 0)
+    if (DULL_OP_IS("add") || DULL_OP_IS("replace") || DULL_OP_IS("test")) {
+        if ((value = dull_patch_member(op, "value", DULL_NULL)) == NULL)
+            return DULL_PATCH_INVALID_OPERATION;
+    }
+    else if (DULL_OP_IS("move") || DULL_OP_IS("copy")) {
+        if ((from = dull_patch_member(op, "from", DULL_STRING)) == NULL || !dull_pointer_valid(from))
+            return DULL_PATCH_INVALID_OPERATION;
+    }
+    else if (!DULL_OP_IS("remove"))
+        return DULL_PATCH_INVALID_OPERATION;
+
+    DULL_INIT(&tmp);
+    if (DULL_OP_IS("test")) {
+        const dull_value* found = dull_pointer_get(root, path->u.s.s, path->u.s.len);
+        if (found == NULL)
+            ret = DULL_PATCH_PATH_NOT_FOUND;
+        else
+            ret = dull_equal(found, value) ? DULL_PATCH_OK : DULL_PATCH_TEST_FAILED;
+    }
+    else if (DULL_OP_IS("remove")) {
+        if ((ret = dull_patch_take(root, path, &log[*n].saved, &log[*n])) == DULL_PATCH_OK)
+            ++*n;
+    }
+    else if (DULL_OP_IS("copy")) {
+        const dull_value* found = dull_pointer_get(root, from->u.s.s, from->u.s.len);
+        if (found == NULL)
+            ret = DULL_PATCH_PATH_NOT_FOUND;
+        else {
+            dull_copy(&tmp, found);
+            if ((ret = dull_patch_add(root, path, 0, &tmp, &log[*n])) == DULL_PATCH_OK)
+                ++*n;
+        }
+    }
+    else if (DULL_OP_IS("move")) {
+        if (from->u.s.len == path->u.s.len && memcmp(from->u.s.s, path->u.s.s, from->u.s.len) == 0)
+            ret = dull_pointer_get(root, from->u.s.s, from->u.s.len) ? DULL_PATCH_OK : DULL_PATCH_PATH_NOT_FOUND;
+        else if (from->u.s.len < path->u.s.len && path->u.s.s[from->u.s.len] == '/' &&
+            memcmp(from->u.s.s, path->u.s.s, from->u.s.len) == 0)
+            /* a value can't be moved into one of its own children */
+            ret = DULL_PATCH_INVALID_OPERATION;
+        else if ((ret = dull_patch_take(root, from, &tmp, &log[*n])) == DULL_PATCH_OK) {
+            dull_undo* taken = &log[(*n)++];
+            if ((ret = dull_patch_add(root, path, 0, &tmp, &log[*n])) == DULL_PATCH_OK) {
+                taken->carry = 1;
+                ++*n;
+            }
+            else
+                dull_move(&taken->saved, &tmp);
+        }
+    }
+    else {
+        dull_copy(&tmp, value);
+        if ((ret = dull_patch_add(root, path, DULL_OP_IS("replace"), &tmp, &log[*n])) == DULL_PATCH_OK)
+            ++*n;
+    }
+#undef DULL_OP_IS
+    dull_free(&tmp);
+    return ret;
+}
+
+int dull_apply_patch(dull_value* v, const dull_value* patch)
+{
+    dull_undo* log;
+    size_t i, n = 0;
+    int ret = DULL_PATCH_OK;
+    assert(v != NULL && patch != NULL);
+    if (patch->type != DULL_ARRAY)
+        return DULL_PATCH_INVALID_OPERATION;
+    /* a move logs two steps, every other operation at most one */
+    log = (dull_undo*)calloc(patch->u.a.size * 2 + 1, sizeof(dull_undo));
+    for (i = 0; i < patch->u.a.size * 2; i++)
+        DULL_INIT(&log[i].saved);
+    for (i = 0; i < patch->u.a.size && ret == DULL_PATCH_OK; i++)
+        ret = dull_patch_op(v, &patch->u.a.e[i], log, &n);
+    if (ret != DULL_PATCH_OK)
+        dull_patch_undo(v, log, n);
+    for (i = 0; i < patch->u.a.size * 2; i++) {
+        free(log[i].key);
+        dull_free(&log[i].saved);
+    }
+    free(log);
+    return ret;
+}
+
+void dull_apply_merge_patch(dull_value* v, const dull_value* patch)
+{
+    size_t i, index;
+    assert(v != NULL && patch != NULL);
+    if (patch->type != DULL_OBJECT) {
+        dull_copy(v, patch);
+        return;
+    }
+    if (v->type != DULL_OBJECT)
+        dull_set_object(v, 0);
+    for (i = 0; i < patch->u.o.size; i++) {
+        const dull_member* m = &patch->u.o.m[i];
+        index = dull_find_object_index(v, m->k, m->klen);
+        if (m->v.type != DULL_NULL)
+            dull_apply_merge_patch(index != DULL_KEY_NOT_EXIST ? &v->u.o.m[index].v
+                : dull_set_object_value(v, m->k, m->klen), &m->v);
+        else if (index != DULL_KEY_NOT_EXIST)
+            dull_remove_object_value(v, index);
+    }
+}
+
+void dull_writer_init(dull_writer* w, char* buf, size_t size, dull_write_func write, void* user)
+{
+    assert(w != NULL && buf != NULL && size > 0 && write != NULL);
+    w->buf = buf;
+    w->size = size;
+    w->top = 0;
+    w->write = write;
+    w->user = user;
+    w->depth = 0;
+    w->after_key = 0;
+    w->done = 0;
+    w->error = DULL_WRITE_OK;
+}
+
+int dull_writer_flush(dull_writer* w)
+{
+    assert(w != NULL);
+    if (w->error != DULL_WRITE_OK)
+        return w->error;
+    if (w->top > 0 && w->write(w->user, w->buf, w->top) != 0)
+        return w->error = DULL_WRITE_FLUSH_ERROR;
+    w->top = 0;
+    return DULL_WRITE_OK;
+}
+
+static int dull_writer_put(dull_writer* w, const char* s, size_t len)
+{
+    while (len > 0) {
+        size_t n;
+        if (w->top == w->size && dull_writer_flush(w) != DULL_WRITE_OK)
+            return w->error;
+        n = w->size - w->top < len ? w->size - w->top : len;
+        memcpy(w->buf + w->top, s, n);
+        w->top += n;
+        s += n;
+        len -= n;
+    }
+    return DULL_WRITE_OK;
+}
+
+static int dull_writer_putc(dull_writer* w, char ch)
+{
+    if (w->top == w->size && dull_writer_flush(w) != DULL_WRITE_OK)
+        return w->error;
+    w->buf[w->top++] = ch;
+    return DULL_WRITE_OK;
+}
+
+#define DULL_WRITER_OBJECT 1
+#define DULL_WRITER_ITEMS  2
+
+/* checks that a key or value may come next and writes the separating comma */
+static int dull_writer_prefix(dull_writer* w, int key)
+{
+    unsigned char* level;
+    if (w->error != DULL_WRITE_OK)
+        return w->error;
+    if (w->depth == 0)
+        return w->done || key ? DULL_WRITE_INVALID_STATE : DULL_WRITE_OK;
+    level = &w->stack[w->depth - 1];
+    if (*level & DULL_WRITER_OBJECT) {
+        if (key == w->after_key)
+            return DULL_WRITE_INVALID_STATE;
+        if (!key) {
+            w->after_key = 0;
+            return DULL_WRITE_OK;
+        }
+    }
+    else if (key)
+        return DULL_WRITE_INVALID_STATE;
+    if (*level & DULL_WRITER_ITEMS)
+        return dull_writer_putc(w, ',');
+    *level |= DULL_WRITER_ITEMS;
+    return DULL_WRITE_OK;
+}
+
+static int dull_writer_begin(dull_writer* w, unsigned char kind, char ch)
+{
+    int ret;
+    if ((ret = dull_writer_prefix(w, 0)) != DULL_WRITE_OK)
+        return ret;
+    if (w->depth == DULL_WRITER_MAX_DEPTH)
+        return DULL_WRITE_TOO_DEEP;
+    w->stack[w->depth++] = kind;
+    return dull_writer_putc(w, ch);
+}
+
+static int dull_writer_end(dull_writer* w, unsigned char kind, char ch)
+{
+    if (w->error != DULL_WRITE_OK)
+        return w->error;
+    if (w->depth == 0 || (w->stack[w->depth - 1] & DULL_WRITER_OBJECT) != kind || w->after_key)
+        return DULL_WRITE_INVALID_STATE;
+    if (--w->depth == 0)
+        w->done = 1;
+    return dull_writer_putc(w, ch);
+}
+
+int dull_writer_begin_object(dull_writer* w)
+{
+    assert(w != NULL);
+    return dull_writer_begin(w, DULL_WRITER_OBJECT, '{');
+}
+
+int dull_writer_end_object(dull_writer* w)
+{
+    assert(w != NULL);
+    return dull_writer_end(w, DULL_WRITER_OBJECT, '}');
+}
+
+int dull_writer_begin_array(dull_writer* w)
+{
+    assert(w != NULL);
+    return dull_writer_begin(w, 0, '[');
+}
+
+int dull_writer_end_array(dull_writer* w)
+{
+    assert(w != NULL);
+    return dull_writer_end(w, 0, ']');
+}
+
+static int dull_writer_quoted(dull_writer* w, const char* s, size_t len)
+{
+    static const char hex_digits[] = "0123456789ABCDEF";
+    const char* run = s;
+    const char* end = s + len;
+    char esc[6] = { '\\', 'u', '0', '0' };
+    if (dull_writer_putc(w, '"') != DULL_WRITE_OK)
+        return w->error;
+    for (; s < end; s++) {
+        unsigned char ch = (unsigned char)*s;
+        if (!dull_escape[ch])
+            continue;
+        /* bytes that need no escaping are copied a run at a time */
+        if (dull_writer_put(w, run, s - run) != DULL_WRITE_OK)
+            return w->error;
+        run = s + 1;
+        if (dull_escape[ch] == 'u') {
+            esc[4] = hex_digits[ch >> 4];
+            esc[5] = hex_digits[ch & 15];
+            dull_writer_put(w, esc, 6);
+        }
+        else {
+            esc[1] = dull_escape[ch];
+            dull_writer_put(w, esc, 2);
+            esc[1] = 'u';
+        }
+    }
+    dull_writer_put(w, run, end - run);
+    return dull_writer_putc(w, '"');
+}
+
+int dull_writer_key(dull_writer* w, const char* k, size_t klen)
+{
+    int ret;
+    assert(w != NULL && (k != NULL || klen == 0));
+    if ((ret = dull_writer_prefix(w, 1)) != DULL_WRITE_OK)
+        return ret;
+    w->after_key = 1;
+    dull_writer_quoted(w, k, klen);
+    return dull_writer_putc(w, ':');
+}
+
+/* a scalar at the root completes the document */
+static int dull_writer_scalar(dull_writer* w, const char* s, size_t len)
+{
+    int ret;
+    if ((ret = dull_writer_prefix(w, 0)) != DULL_WRITE_OK)
+        return ret;
+    if (w->depth == 0)
+        w->done = 1;
+    return dull_writer_put(w, s, len);
+}
+
+int dull_writer_string(dull_writer* w, const char* s, size_t len)
+{
+    int ret;
+    assert(w != NULL && (s != NULL || len == 0));
+    if ((ret = dull_writer_prefix(w, 0)) != DULL_WRITE_OK)
+        return ret;
+    if (w->depth == 0)
+        w->done = 1;
+    return dull_writer_quoted(w, s, len);
+}
+
+int dull_writer_number(dull_writer* w, double n)
+{
+    char buf[32];
+    assert(w != NULL);
+    if (!isfinite(n))
+        return DULL_WRITE_INVALID_NUMBER;
+    return dull_writer_scalar(w, buf, sprintf(buf, "%.17g", n));
+}
+
+int dull_writer_boolean(dull_writer* w, int b)
+{
+    assert(w != NULL);
+    return b ? dull_writer_scalar(w, "true", 4) : dull_writer_scalar(w, "false", 5);
+}
+
+int dull_writer_null(dull_writer* w)
+{
+    assert(w != NULL);
+    return dull_writer_scalar(w, "null", 4);
+}
+
+int dull_writer_value(dull_writer* w, const dull_value* v)
+{
+    size_t i;
+    int ret;
+    assert(w != NULL && v != NULL);
+    switch (v->type) {
+        case DULL_NULL:   return dull_writer_null(w);
+        case DULL_FALSE:  return dull_writer_boolean(w, 0);
+        case DULL_TRUE:   return dull_writer_boolean(w, 1);
+        case DULL_NUMBER: return dull_writer_number(w, v->u.n);
+        case DULL_STRING: return dull_writer_string(w, v->u.s.s, v->u.s.len);
+        case DULL_ARRAY:
+            if ((ret = dull_writer_begin_array(w)) != DULL_WRITE_OK)
+                return ret;
+            for (i = 0; i < v->u.a.size; i++)
+                if ((ret = dull_writer_value(w, &v->u.a.e[i])) != DULL_WRITE_OK)
+                    return ret;
+            return dull_writer_end_array(w);
+        case DULL_OBJECT:
+            if ((ret = dull_writer_begin_object(w)) != DULL_WRITE_OK)
+                return ret;
+            for (i = 0; i < v->u.o.size; i++) {
+                if ((ret = dull_writer_key(w, v->u.o.m[i].k, v->u.o.m[i].klen)) != DULL_WRITE_OK)
+                    return ret;
+                if ((ret = dull_writer_value(w, &v->u.o.m[i].v)) != DULL_WRITE_OK)
+                    return ret;
+            }
+            return dull_writer_end_object(w);
+        default:
+            assert(0 && "invalid type");
+            return DULL_WRITE_INVALID_STATE;
+    }
+}
+
+#ifndef DULL_INDEX_MIN_SIZE
+#define DULL_INDEX_MIN_SIZE 8
+#endif
+
+/* one key of one object in a frozen document */
+typedef struct
+{
+    const dull_value* object;
+    const dull_member* member;
+} dull_index_entry;
+
+/* read-only once published, so readers never synchronize beyond the acquire load */
+typedef struct
+{
+    size_t mask;
+    dull_index_entry* entries;
+} dull_index;
+
+struct dull_document
+{
+    dull_value root;
+    dull_atomic_count refs;
+    dull_atomic_ptr index;  /* dull_index* */
+};
+
+dull_document* dull_freeze(dull_value* v)
+{
+    dull_document* d;
+    assert(v != NULL);
+    d = (dull_document*)malloc(sizeof(dull_document));
+    DULL_INIT(&d->root);
+    dull_move(&d->root, v);
+    DULL_ATOMIC_INIT(&d->refs, 1);
+    DULL_ATOMIC_INIT(&d->index, NULL);
+    return d;
+}
+
+dull_document* dull_document_retain(dull_document* d)
+{
+    assert(d != NULL);
+    DULL_ATOMIC_INC(&d->refs);
+    return d;
+}
+
+void dull_document_release(dull_document* d)
+{
+    dull_index* index;
+    if (d == NULL)
+        return;
+    /* acquire too, so the last owner sees every other reader's work before freeing */
+    if (DULL_ATOMIC_DEC(&d->refs) != 0)
+        return;
+    if ((index = (dull_index*)DULL_ATOMIC_LOAD(&d->index)) != NULL) {
+        free(index->entries);
+        free(index);
+    }
+    dull_free(&d->root);
+    free(d);
+}
+
+const dull_value* dull_document_root(const dull_document* d)
+{
+    assert(d != NULL);
+    return &d->root;
+}
+
+static size_t dull_index_hash(const dull_value* object, const char* key, size_t klen)
+{
+    size_t i, h = (size_t)14695981039346656037ULL ^ (size_t)object;
+    for (i = 0; i < klen; i++) {
+        h ^= (unsigned char)key[i];
+        h *= (size_t)1099511628211ULL;
+    }
+    return h ^ (h >> 29);
+}
+
+static size_t dull_index_count(const dull_value* v)
+{
+    size_t i, n = 0;
+    if (v->type == DULL_ARRAY)
+        for (i = 0; i < v->u.a.size; i++)
+            n += dull_index_count(&v->u.a.e[i]);
+    else if (v->type == DULL_OBJECT) {
+        if (v->u.o.size >= DULL_INDEX_MIN_SIZE)
+            n += v->u.o.size;
+        for (i = 0; i < v->u.o.size; i++)
+            n += dull_index_count(&v->u.o.m[i].v);
+    }
+    return n;
+}
+
+static void dull_index_fill(dull_index* index, const dull_value* v)
+{
+    size_t i, h;
+    if (v->type == DULL_ARRAY)
+        for (i = 0; i < v->u.a.size; i++)
+            dull_index_fill(index, &v->u.a.e[i]);
+    else if (v->type == DULL_OBJECT) {
+        for (i = 0; i < v->u.o.size; i++) {
+            const dull_member* m = &v->u.o.m[i];
+            if (v->u.o.size >= DULL_INDEX_MIN_SIZE) {
+                /* a duplicate key keeps its first slot, like the linear search */
+                h = dull_index_hash(v, m->k, m->klen) & index->mask;
+                while (index->entries[h].object != NULL &&
+                    !(index->entries[h].object == v && index->entries[h].member->klen == m->klen &&
+                    memcmp(index->entries[h].member->k, m->k, m->klen) == 0))
+                    h = (h + 1) & index->mask;
+                if (index->entries[h].object == NULL) {
+                    index->entries[h].object = v;
+                    index->entries[h].member = m;
+                }
+            }
+            dull_index_fill(index, &m->v);
+        }
+    }
+}
+
+/* builds every large object's key table in one pass, the first caller to finish publishes it */
+static dull_index* dull_document_index(dull_document* d)
+{
+    dull_index* index = (dull_index*)DULL_ATOMIC_LOAD(&d->index);
+    void* expected = NULL;
+    size_t size = 1, count;
+    if (index != NULL)
+        return index;
+    count = dull_index_count(&d->root);
+    while (size < count * 2)
+        size *= 2;
+    index = (dull_index*)malloc(sizeof(dull_index));
+    index->mask = size - 1;
+    index->entries = (dull_index_entry*)calloc(size, sizeof(dull_index_entry));
+    dull_index_fill(index, &d->root);
+    if (!DULL_ATOMIC_CAS(&d->index, &expected, (void*)index)) {
+        free(index->entries);
+        free(index);
+        index = (dull_index*)expected;
+    }
+    return index;
+}
+
+const dull_value* dull_document_find(dull_document* d, const dull_value* object, const char* key, size_t klen)
+{
+    const dull_index* index;
+    size_t i, h;
+    assert(d != NULL && object != NULL && object->type == DULL_OBJECT && key != NULL);
+    if (object->u.o.size < DULL_INDEX_MIN_SIZE) {
+        for (i = 0; i < object->u.o.size; i++)
+            if (object->u.o.m[i].klen == klen && memcmp(object->u.o.m[i].k, key, klen) == 0)
+                return &object->u.o.m[i].v;
+        return NULL;
+    }
+    index = dull_document_index(d);
+    for (h = dull_index_hash(object, key, klen) & index->mask; index->entries[h].object != NULL; h = (h + 1) & index->mask) {
+        const dull_index_entry* e = &index->entries[h];
+        if (e->object == object && e->member->klen == klen && memcmp(e->member->k, key, klen) == 0)
+            return &e->member->v;
+    }
+    return NULL;
+}
+
+/*
+ * minifying happens in two steps over one read of the input. dull_minify_compact()
+ * drops the whitespace outside strings into out, then a walker over the grammar
+ * validates the compacted text, which is as valid as the input was: the only
+ * whitespace the walker cares about separates two scalar bytes, as in "1 2" or
+ * "tr ue", and that is never valid JSON, so the compactor stops there and hands
+ * the rest over as it is. out never gets ahead of the input it came from, so in
+ * and out may be the same buffer.
+ */
+typedef struct
+{
+    const char* p;
+    const char* end;
+    const char* done;  /* text before this has been rewritten into out */
+    char* out;
+    int flags;
+    dull_context c;  /* decoding stack for DULL_MINIFY_REESCAPE */
+} dull_minifier;
+
+#define MINIFY_CH(m) ((m)->p < (m)->end ? *(m)->p : '\0')
+#define ISWHITESPACE(ch) ((ch) == ' ' || (ch) == '\t' || (ch) == '\n' || (ch) == '\r')
+/* bytes of numbers, literals and garbage, which whitespace keeps apart */
+#define ISSCALAR(ch) (!ISWHITESPACE(ch) && (ch) != '"' && (ch) != ',' && (ch) != ':' && \
+    (ch) != '[' && (ch) != ']' && (ch) != '{' && (ch) != '}')
+
+#if defined(__SSE2__) && !defined(DULL_NO_SSE2)
+#define DULL_MINIFY_SSE2
+#endif
+
+#ifdef DULL_MINIFY_SSE2
+static unsigned dull_whitespace_mask16(__m128i x)
+{
+    __m128i ws = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(x, _mm_set1_epi8('\t'))),
+        _mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(x, _mm_set1_epi8('\r'))));
+    return (unsigned)_mm_movemask_epi8(ws);
+}
+
+/* bit i is set where byte i of x is one of the punctuation bytes ,:[]{} */
+static unsigned dull_punct_mask16(__m128i x)
+{
+    /* '[' ']' and '{' '}' differ from each other only in bit 5 */
+    __m128i brackets = _mm_or_si128(x, _mm_set1_epi8(0x20));
+    __m128i punct = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8(',')), _mm_cmpeq_epi8(x, _mm_set1_epi8(':'))),
+        _mm_or_si128(_mm_cmpeq_epi8(brackets, _mm_set1_epi8('{')), _mm_cmpeq_epi8(brackets, _mm_set1_epi8('}'))));
+    return (unsigned)_mm_movemask_epi8(punct);
+}
+
+/*
+ * the bytes of a 64-byte block that follow an odd run of backslashes.
+ * *carry says whether the first byte is escaped by the previous block.
+ */
+static unsigned long long dull_minify_escaped(unsigned long long backslash, unsigned long long* carry)
+{
+    const unsigned long long even = 0x5555555555555555ULL;
+    unsigned long long follows, odd_starts, sum;
+    backslash &= ~*carry;
+    follows = backslash << 1 | *carry;
+    odd_starts = backslash & ~even & ~follows;
+    sum = odd_starts + backslash;
+    *carry = sum < odd_starts;
+    return (even ^ sum << 1) & follows;
+}
+
+/*
+ * copies the set bits of keep from the n valid bytes of block to out, a run at a
+ * time. short runs are stored as 16 bytes where that stays inside the n bytes,
+ * as out is never ahead of the block's place in the input.
+ */
+static char* dull_minify_runs(char* out, const char* block, unsigned long long keep, unsigned n)
+{
+    unsigned i = 0;
+    if (keep == ~0ULL) {
+        memcpy(out, block, 64);
+        return out + 64;
+    }
+    while (keep != 0) {
+        unsigned skip = (unsigned)__builtin_ctzll(keep);
+        unsigned long long rest = ~(keep >> skip);
+        unsigned run = rest != 0 ? (unsigned)__builtin_ctzll(rest) : 64 - skip;
+        i += skip;
+        if (run <= 16 && i + 16 <= n)
+            _mm_storeu_si128((__m128i*)out, _mm_loadu_si128((const __m128i*)(block + i)));
+        else
+            memcpy(out, block + i, run);
+        out += run;
+        i += run;
+        keep = i < 64 ? keep >> (skip + run) : 0;
+    }
+    return out;
+}
+#endif
+
+/*
+ * drops the whitespace outside strings from [p, end) into out and returns the
+ * new end of out. if whitespace separates two scalar bytes it sets *rest to
+ * where the uncompacted rest starts, after writing a space to out if the rest
+ * starts past that whitespace; otherwise *rest is NULL.
+ * the SSE2 path classifies 64 bytes at a time: backslashes give the escaped
+ * bytes, a prefix xor over the other quotes gives the bytes inside strings, and
+ * adding the whitespace after a scalar byte to the whitespace mask carries out
+ * of each such gap onto the byte that ends it.
+ */
+static char* dull_minify_compact(const char* p, const char* end, char* out, const char** rest)
+{
+#ifdef DULL_MINIFY_SSE2
+    unsigned long long escape_carry = 0, string_carry = 0, scalar_carry = 0, gap_carry = 0;
+    char block[64];
+    *rest = NULL;
+    while (p < end) {
+        unsigned long long ws = 0, quote = 0, bslash = 0, punct = 0, in_string, scalar, gap, after;
+        unsigned n = end - p < 64 ? (unsigned)(end - p) : 64;
+        int k;
+        /* out may be in, so the block is copied out before anything is written */
+        if (n == 64)
+            memcpy(block, p, 64);
+        else {
+            memcpy(block, p, n);
+            memset(block + n, ' ', 64 - n);
+        }
+        for (k = 0; k < 4; k++) {
+            __m128i x = _mm_loadu_si128((const __m128i*)(block + 16 * k));
+            ws |= (unsigned long long)dull_whitespace_mask16(x) << 16 * k;
+            punct |= (unsigned long long)dull_punct_mask16(x) << 16 * k;
+            quote |= (unsigned long long)(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(x, _mm_set1_epi8('"'))) << 16 * k;
+            bslash |= (unsigned long long)(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(x, _mm_set1_epi8('\\'))) << 16 * k;
+        }
+        in_string = quote & ~dull_minify_escaped(bslash, &escape_carry);
+        in_string ^= in_string << 1;
+        in_string ^= in_string << 2;
+        in_string ^= in_string << 4;
+        in_string ^= in_string << 8;
+        in_string ^= in_string << 16;
+        in_string ^= in_string << 32;
+        in_string ^= string_carry;
+        string_carry = in_string >> 63 ? ~0ULL : 0;
+        ws &= ~in_string;
+        scalar = ~(ws | punct | quote | in_string);
+        gap = (scalar << 1 | scalar_carry | gap_carry) & ws;
+        after = ws + gap;
+        if ((after & ~ws & scalar) != 0 || (gap_carry & scalar & 1) != 0) {
+            if (gap_carry)
+                *out++ = ' ';
+            *rest = p;
+            return out;
+        }
+        gap_carry = after < ws;
+        scalar_carry = scalar >> 63;
+        /* an unterminated string would keep the padding */
+        out = dull_minify_runs(out, block, n < 64 ? ~ws & ((1ULL << n) - 1) : ~ws, n);
+        p += n;
+    }
+    return out;
+#else
+    int after_scalar = 0;
+    *rest = NULL;
+    while (p < end) {
+        const char* run = p;
+        while (p < end && !ISWHITESPACE(*p)) {
+            after_scalar = ISSCALAR(*p);
+            if (*p++ == '"') {
+                while (p < end && *p != '"') {
+                    if (*p == '\\' && end - p > 1)
+                        p++;
+                    p++;
+                }
+                if (p < end)
+                    p++;
+            }
+        }
+        if (out != run)
+            memmove(out, run, p - run);
+        out += p - run;
+        while (p < end && ISWHITESPACE(*p))
+            p++;
+        if (after_scalar && p < end && ISSCALAR(*p)) {
+            *out++ = ' ';
+            *rest = p;
+            return out;
+        }
+    }
+    return out;
+#endif
+}
+
+/* moves the text before upto down to out, behind what DULL_MINIFY_REESCAPE rewrote */
+static void dull_minify_flush(dull_minifier* m, const char* upto)
+{
+    size_t n = upto - m->done;
+    if (m->out != m->done)
+        memmove(m->out, m->done, n);
+    m->out += n;
+    m->done = upto;
+}
+
+static void dull_minify_whitespace(dull_minifier* m)
+{
+    const char* p = m->p;
+    while (p < m->end && ISWHITESPACE(*p))
+        p++;
+    m->p = p;
+}
+
+static int dull_minify_literal(dull_minifier* m, const char* literal, size_t n)
+{
+    if ((size_t)(m->end - m->p) < n || memcmp(m->p, literal, n) != 0)
+        return DULL_PARSE_INVALID_VALUE;
+    m->p += n;
+    return DULL_PARSE_OK;
+}
+
+/* the grammar of dull_parse_number() without the conversion, so huge exponents pass */
+static int dull_minify_number(dull_minifier* m)
+{
+    const char* p = m->p;
+    const char* end = m->end;
+    if (p < end && *p == '-') p++;
+    if (p < end && *p == '0') p++;
+    else {
+        if (p == end || !ISDIGIT1TO9(*p)) return DULL_PARSE_INVALID_VALUE;
+        for (p++; p < end && ISDIGIT(*p); p++);
+    }
+    if (p < end && *p == '.') {
+        p++;
+        if (p == end || !ISDIGIT(*p)) return DULL_PARSE_INVALID_VALUE;
+        for (p++; p < end && ISDIGIT(*p); p++);
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        p++;
+        if (p < end && (*p == '-' || *p == '+')) p++;
+        if (p == end || !ISDIGIT(*p)) return DULL_PARSE_INVALID_VALUE;
+        for (p++; p < end && ISDIGIT(*p); p++);
+    }
+    m->p = p;
+    return DULL_PARSE_OK;
+}
+
+/*
+ * validates a string literal and leaves m->p past its closing quote.
+ * *escaped is set when the literal holds an escape.
+ */
+static int dull_minify_scan_string(dull_minifier* m, int* escaped)
+{
+    const char* p = m->p + 1;
+    const char* end = m->end;
+    unsigned u, u2;
+    for (;;) {
+#ifdef DULL_MINIFY_SSE2
+        /* skip 16 plain bytes at a time, stopping at a quote, backslash or control char */
+        const __m128i quote = _mm_set1_epi8('"');
+        const __m128i bslash = _mm_set1_epi8('\\');
+        const __m128i ctrl = _mm_set1_epi8(0x1F);
+        while (end - p >= 16) {
+            __m128i x = _mm_loadu_si128((const __m128i*)p);
+            __m128i hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(x, quote), _mm_cmpeq_epi8(x, bslash)),
+                _mm_cmpeq_epi8(_mm_max_epu8(x, ctrl), ctrl));
+            int mask = _mm_movemask_epi8(hit);
+            if (mask != 0) {
+                p += __builtin_ctz(mask);
+                break;
+            }
+            p += 16;
+        }
+#endif
+        if (p == end) {
+            m->p = p;
+            return DULL_PARSE_MISS_QUOTATION_MARK;
+        }
+        switch (*p) {
+        case '"':
+            m->p = p + 1;
+            return DULL_PARSE_OK;
+        case '\\':
+            *escaped = 1;
+            if (end - p < 2)
+                return DULL_PARSE_INVALID_STRING_ESCAPE;
+            if (p[1] != 'u') {
+                if (!dull_unescape[(unsigned char)p[1]])
+                    return DULL_PARSE_INVALID_STRING_ESCAPE;
+                p += 2;
+                break;
+            }
+            if (end - p < 6 || !dull_parse_hex4(p + 2, &u))
+                return DULL_PARSE_INVALID_UNICODE_HEX;
+            p += 6;
+            if (u >= 0xD800 && u <= 0xDBFF) {
+                if (end - p < 2 || p[0] != '\\' || p[1] != 'u')
+                    return DULL_PARSE_INVALID_UNICODE_SURROGATE;
+                if (end - p < 6 || !dull_parse_hex4(p + 2, &u2))
+                    return DULL_PARSE_INVALID_UNICODE_HEX;
+                if (u2 < 0xDC00 || u2 > 0xDFFF)
+                    return DULL_PARSE_INVALID_UNICODE_SURROGATE;
+                p += 6;
+            }
+            break;
+        default:
+            if ((unsigned char)*p < 0x20)
+                return DULL_PARSE_INVALID_STRING_CHAR;
+            p++;
+        }
+    }
+}
+
+/* decodes an already validated literal and writes it back with the writer's escapes */
+static void dull_minify_reescape(dull_minifier* m, const char* start)
+{
+    static const char hex_digits[] = "0123456789ABCDEF";
+    char* str;
+    size_t i, len;
+    int ret;
+    m->c.json = start;
+    ret = dull_parse_string_raw(&m->c, &str, &len);
+    assert(ret == DULL_PARSE_OK && m->c.json == m->p);
+    (void)ret;
+    /* decoding never grows a literal and escaping restores at most its original length */
+    *m->out++ = '"';
+    for (i = 0; i < len; i++) {
+        unsigned char ch = (unsigned char)str[i];
+        char e = dull_escape[ch];
+        if (!e)
+            *m->out++ = (char)ch;
+        else if (e != 'u') {
+            *m->out++ = '\\';
+            *m->out++ = e;
+        }
+        else {
+            memcpy(m->out, "\\u00", 4);
+            m->out[4] = hex_digits[ch >> 4];
+            m->out[5] = hex_digits[ch & 15];
+            m->out += 6;
+        }
+    }
+    *m->out++ = '"';
+}
+
+static int dull_minify_string(dull_minifier* m)
+{
+    const char* start = m->p;
+    int ret, escaped = 0;
+    if ((ret = dull_minify_scan_string(m, &escaped)) != DULL_PARSE_OK)
+        return ret;
+    /* a literal without escapes is already written the writer's way */
+    if (escaped && (m->flags & DULL_MINIFY_REESCAPE)) {
+        dull_minify_flush(m, start);
+        dull_minify_reescape(m, start);
+        m->done = m->p;
+    }
+    return DULL_PARSE_OK;
+}
+
+static int dull_minify_value(dull_minifier* m)
+{
+    int ret;
+    char close;
+    switch (MINIFY_CH(m))
+    {
+        case 'n': return dull_minify_literal(m, "null", 4);
+        case 't': return dull_minify_literal(m, "true", 4);
+        case 'f': return dull_minify_literal(m, "false", 5);
+        case '"': return dull_minify_string(m);
+        case '[':
+        case '{':
+            close = *m->p == '[' ? ']' : '}';
+            m->p++;
+            dull_minify_whitespace(m);
+            if (MINIFY_CH(m) == close) {
+                m->p++;
+                return DULL_PARSE_OK;
+            }
+            for (;;) {
+                if (close == '}') {
+                    if (MINIFY_CH(m) != '"')
+                        return DULL_PARSE_MISS_KEY;
+                    if ((ret = dull_minify_string(m)) != DULL_PARSE_OK)
+                        return ret;
+                    dull_minify_whitespace(m);
+                    if (MINIFY_CH(m) != ':')
+                        return DULL_PARSE_MISS_COLON;
+                    m->p++;
+                    dull_minify_whitespace(m);
+                }
+                if ((ret = dull_minify_value(m)) != DULL_PARSE_OK)
+                    return ret;
+                dull_minify_whitespace(m);
+                if (MINIFY_CH(m) == close) {
+                    m->p++;
+                    return DULL_PARSE_OK;
+                }
+                if (MINIFY_CH(m) != ',')
+                    return close == ']' ? DULL_PARSE_MISS_COMMA_OR_SQUARE_BRACKET : DULL_PARSE_MISS_COMMA_OR_CURLY_BRACKET;
+                m->p++;
+                dull_minify_whitespace(m);
+            }
+        case '\0': return m->p == m->end ? DULL_PARSE_EXPECT_VALUE : DULL_PARSE_INVALID_VALUE;
+        default: return dull_minify_number(m);
+    }
+}
+
+static int dull_minify_run(const char* in, size_t len, char* out, int flags, size_t* out_len)
+{
+    dull_minifier m;
+    const char* rest;
+    char* end = dull_minify_compact(in, in + len, out, &rest);
+    int ret;
+    if (rest != NULL) {
+        /* the input is invalid, the walker just has to find out how */
+        memmove(end, rest, in + len - rest);
+        end += in + len - rest;
+        flags = 0;
+    }
+    m.p = m.done = m.out = out;
+    m.end = end;
+    m.flags = flags;
+    dull_reader_init(&m.c, out);
+    dull_minify_whitespace(&m);
+    if ((ret = dull_minify_value(&m)) == DULL_PARSE_OK) {
+        dull_minify_whitespace(&m);
+        if (m.p != m.end)
+            ret = DULL_PARSE_ROOT_NOT_SINGULAR;
+    }
+    dull_reader_free(&m.c);
+    assert(rest == NULL || ret != DULL_PARSE_OK);
+    if (ret == DULL_PARSE_OK) {
+        dull_minify_flush(&m, m.end);
+        *out_len = (size_t)(m.out - out);
+    }
+    return ret;
+}
+
+int dull_minify(const char* in, size_t len, char* out, size_t* out_len, int flags)
+{
+    int ret;
+    assert(in != NULL && out != NULL && out_len != NULL);
+    if ((ret = dull_minify_run(in, len, out, flags, out_len)) != DULL_PARSE_OK)
+        *out_len = 0;
+    return ret;
+}
+
+int dull_minify_inplace(char* json, size_t* len, int flags)
+{
+    /* one pass into scratch, so json is only overwritten once all of it is valid */
+    char* scratch;
+    size_t n;
+    int ret;
+    assert(json != NULL && len != NULL);
+    scratch = (char*)malloc(*len ? *len : 1);
+    if ((ret = dull_minify_run(json, *len, scratch, flags, &n)) == DULL_PARSE_OK) {
+        memcpy(json, scratch, n);
+        *len = n;
+    }
+    free(scratch);
+    return ret;
+}
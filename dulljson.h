@@ -3,20 +3,32 @@
 
 #include <stddef.h>
 
-#define DULL_INIT(v) do{(v)->type = DULL_NULL;}while(0)
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DULL_INIT(v) do{(v)->type = DULL_NULL; (v)->flags = 0;}while(0)
 #define dull_set_null(v) dull_free(v)
 
 typedef enum {DULL_NULL, DULL_FALSE, DULL_TRUE, DULL_NUMBER, DULL_STRING, DULL_ARRAY, DULL_OBJECT} dull_type;
 
+/* storage ownership of a node, see dull_copy() */
+enum {
+    DULL_F_BLOCK    = 1,  /* owns one block holding the storage of its whole subtree */
+    DULL_F_POOLED   = 2,  /* storage lives in an ancestor's block, never freed directly */
+    DULL_F_DETACHED = 4   /* storage of its own after growing, descendants may still be pooled */
+};
+
 typedef struct dull_value dull_value;
 typedef struct dull_member dull_member;
 struct dull_value
 {
     dull_type type;
+    unsigned flags;
     union
     {
-        struct { dull_member* m; size_t size;} o;
-        struct { dull_value* e; size_t size;} a;
+        struct { dull_member* m; size_t size, capacity;} o;
+        struct { dull_value* e; size_t size, capacity;} a;
         struct { char* s; size_t len; } s;
         double n;
     } u;
@@ -44,10 +56,65 @@ enum {
     DULL_PARSE_MISS_COMMA_OR_SQUARE_BRACKET,
     DULL_PARSE_MISS_KEY,
     DULL_PARSE_MISS_COLON,
-    DULL_PARSE_MISS_COMMA_OR_CURLY_BRACKET
+    DULL_PARSE_MISS_COMMA_OR_CURLY_BRACKET,
+    DULL_PARSE_FILE_ERROR,
+    DULL_PARSE_INVALID_SNAPSHOT,
+    DULL_PARSE_TYPE_MISMATCH,
+    DULL_PARSE_PENDING
+};
+
+/* hints for dull_parse_file(), ignored where the platform has no mmap */
+enum {
+    DULL_FILE_POPULATE = 1,  /* prefault the whole mapping up front */
+    DULL_FILE_HUGEPAGE = 2   /* ask for transparent huge pages */
 };
 
+typedef struct
+{
+    int code;       /* DULL_PARSE_* */
+    size_t offset;  /* byte offset of the failing token, 0 on success */
+    size_t line;    /* 1-based, computed only on error */
+    size_t column;  /* 1-based byte column, computed only on error */
+} dull_parse_result;
+
+/*
+ * filled by dull_parse_stats_ex(). the counting is compiled in only when
+ * DULL_PARSE_STATS is defined; otherwise every field stays zero.
+ */
+typedef struct
+{
+    size_t nodes[DULL_OBJECT + 1];  /* values parsed, indexed by dull_type */
+    size_t string_bytes;            /* decoded bytes of strings and keys */
+    size_t escapes;                 /* escape sequences decoded */
+    size_t heap_allocs;             /* mallocs for strings, keys, elements and members */
+    size_t stack_allocs;            /* first allocation of the parse stack */
+    size_t stack_reallocs;          /* growths of the parse stack */
+    size_t max_depth;               /* deepest array or object nesting */
+    double total_ns;                /* wall time of the whole parse */
+    double string_ns;               /* decoding strings and keys */
+    double number_ns;               /* scanning and converting numbers */
+} dull_parse_stats;
+
 int dull_parse(dull_value* v, const char* json);
+int dull_parse_ex(dull_value* v, const char* json, dull_parse_result* r);
+int dull_parse_stats_ex(dull_value* v, const char* json, dull_parse_stats* stats);
+/*
+ * a parse that runs in slices. each dull_async_parse_step() consumes about
+ * budget bytes of json, finishing the token it is in, and returns
+ * DULL_PARSE_PENDING until the parse is over. the open arrays and objects
+ * live in the parser, not on the call stack. json must stay alive and
+ * terminated until dull_async_parse_end(), which frees the parser, fills r
+ * when given and returns the final code, or DULL_PARSE_PENDING for a parse
+ * given up early. v stays null unless the code is DULL_PARSE_OK.
+ */
+typedef struct dull_async_parser dull_async_parser;
+
+dull_async_parser* dull_async_parse_begin(dull_value* v, const char* json);
+int dull_async_parse_step(dull_async_parser* p, size_t budget);
+int dull_async_parse_end(dull_async_parser* p, dull_parse_result* r);
+
+int dull_parse_file(dull_value* v, const char* path, int flags);
+int dull_parse_file_ex(dull_value* v, const char* path, int flags, dull_parse_result* r);
 dull_type dull_get_type(const dull_value* v);
 
 double dull_get_number(const dull_value* v);
@@ -61,13 +128,154 @@ int dull_get_string_length(const dull_value* v);
 void dull_set_string(dull_value* v, const char* c, size_t len);
 
 void dull_free(dull_value* v);
+void dull_copy(dull_value* dst, const dull_value* src);
+void dull_move(dull_value* dst, dull_value* src);
+void dull_swap(dull_value* lhs, dull_value* rhs);
+
+/* member order doesn't matter, except that repeated keys must repeat in the same order */
+int dull_equal(const dull_value* lhs, const dull_value* rhs);
+size_t dull_hash(const dull_value* v);
+
+/* token-level access to the parser's scanners, for readers that skip the tree */
+typedef struct
+{
+    const char* json;
+    char* stack;
+    size_t top, size;
+    dull_parse_stats* stats;
+    size_t depth;
+} dull_reader;
+
+void dull_reader_init(dull_reader* r, const char* json);
+void dull_reader_free(dull_reader* r);
+char dull_reader_peek(dull_reader* r);
+int dull_reader_number(dull_reader* r, double* n);
+int dull_reader_boolean(dull_reader* r, int* b);
+int dull_reader_string(dull_reader* r, const char** s, size_t* len);
+int dull_reader_skip(dull_reader* r);
+
+/*
+ * a frozen, reference-counted tree. any number of threads may read it and
+ * retain or release it concurrently; the last release frees it. lookups in
+ * large objects go through a key index built on first use and published
+ * without locks. dull_document_find only knows the objects of d's own tree:
+ * object must be d's root or reached from it, anything else may find nothing.
+ */
+typedef struct dull_document dull_document;
+
+dull_document* dull_freeze(dull_value* v);
+dull_document* dull_document_retain(dull_document* d);
+void dull_document_release(dull_document* d);
+const dull_value* dull_document_root(const dull_document* d);
+const dull_value* dull_document_find(dull_document* d, const dull_value* object, const char* key, size_t klen);
 
-size_t dull_get_array_size(dull_value* v);
+/*
+ * strips insignificant whitespace from len bytes of JSON without building a
+ * tree, validating the structure on the way. in needs no terminator; out must
+ * hold len bytes and may be in itself. string literals are copied verbatim
+ * unless DULL_MINIFY_REESCAPE asks for them to be rewritten with minimal escapes.
+ * on error dull_minify sets *out_len to 0 and out holds partial output, which
+ * clobbers in when they are the same buffer. dull_minify_inplace compacts into
+ * a scratch buffer of len bytes and copies it back only once the whole input
+ * has validated, so on error json and *len are left as they were.
+ */
+enum {
+    DULL_MINIFY_REESCAPE = 1
+};
+
+int dull_minify(const char* in, size_t len, char* out, size_t* out_len, int flags);
+int dull_minify_inplace(char* json, size_t* len, int flags);
+
+int dull_save_snapshot(const dull_value* v, const char* path);
+int dull_load_snapshot(dull_value* v, const char* path);
+
+void dull_set_array(dull_value* v, size_t capacity);
+size_t dull_get_array_size(const dull_value* v);
+size_t dull_get_array_capacity(const dull_value* v);
+void dull_reserve_array(dull_value* v, size_t capacity);
+void dull_shrink_array(dull_value* v);
+void dull_clear_array(dull_value* v);
 dull_value* dull_get_array_element(dull_value* v, size_t index);
+const dull_value* dull_get_array_element_const(const dull_value* v, size_t index);
+dull_value* dull_pushback_array_element(dull_value* v);
+void dull_popback_array_element(dull_value* v);
+dull_value* dull_insert_array_element(dull_value* v, size_t index);
+void dull_remove_array_element(dull_value* v, size_t index, size_t count);
 
+#define DULL_KEY_NOT_EXIST ((size_t)-1)
+
+void dull_set_object(dull_value* v, size_t capacity);
 size_t dull_get_object_size(const dull_value* v);
+size_t dull_get_object_capacity(const dull_value* v);
+void dull_reserve_object(dull_value* v, size_t capacity);
+void dull_shrink_object(dull_value* v);
+void dull_clear_object(dull_value* v);
 const char* dull_get_object_key(const dull_value* v, size_t index);
 size_t dull_get_object_key_length(const dull_value* v, size_t index);
 dull_value* dull_get_object_value(const dull_value* v, size_t index);
+size_t dull_find_object_index(const dull_value* v, const char* key, size_t klen);
+dull_value* dull_find_object_value(dull_value* v, const char* key, size_t klen);
+const dull_value* dull_find_object_value_const(const dull_value* v, const char* key, size_t klen);
+dull_value* dull_set_object_value(dull_value* v, const char* key, size_t klen);
+void dull_remove_object_value(dull_value* v, size_t index);
+
+enum {
+    DULL_PATCH_OK = 0,
+    DULL_PATCH_INVALID_OPERATION,
+    DULL_PATCH_PATH_NOT_FOUND,
+    DULL_PATCH_TEST_FAILED
+};
+
+/*
+ * applies an RFC 6902 JSON Patch in place. only the containers on the touched
+ * paths change, also in a tree from dull_copy() or a snapshot, where just those
+ * leave the block. when an operation fails every earlier one is undone.
+ */
+int dull_apply_patch(dull_value* v, const dull_value* patch);
+/* applies an RFC 7386 Merge Patch in place, which can't fail */
+void dull_apply_merge_patch(dull_value* v, const dull_value* patch);
+
+#ifndef DULL_WRITER_MAX_DEPTH
+#define DULL_WRITER_MAX_DEPTH 128
+#endif
+
+enum {
+    DULL_WRITE_OK = 0,
+    DULL_WRITE_INVALID_STATE,
+    DULL_WRITE_INVALID_NUMBER,
+    DULL_WRITE_TOO_DEEP,
+    DULL_WRITE_FLUSH_ERROR
+};
+
+/* receives each full buffer, returns 0 on success */
+typedef int (*dull_write_func)(void* user, const char* data, size_t len);
+
+typedef struct
+{
+    char* buf;
+    size_t size, top;
+    dull_write_func write;
+    void* user;
+    unsigned depth;
+    int after_key, done, error;
+    unsigned char stack[DULL_WRITER_MAX_DEPTH];
+} dull_writer;
+
+void dull_writer_init(dull_writer* w, char* buf, size_t size, dull_write_func write, void* user);
+int dull_writer_flush(dull_writer* w);
+int dull_writer_begin_object(dull_writer* w);
+int dull_writer_end_object(dull_writer* w);
+int dull_writer_begin_array(dull_writer* w);
+int dull_writer_end_array(dull_writer* w);
+int dull_writer_key(dull_writer* w, const char* k, size_t klen);
+int dull_writer_string(dull_writer* w, const char* s, size_t len);
+int dull_writer_number(dull_writer* w, double n);
+int dull_writer_boolean(dull_writer* w, int b);
+int dull_writer_null(dull_writer* w);
+int dull_writer_value(dull_writer* w, const dull_value* v);
+
+#ifdef __cplusplus
+}
+#endif
 
 #endif /* DULLJSON_H__ */
\ No newline at end of file
@@ -0,0 +1,654 @@
+#ifndef DULLJSON_HPP__
+#define DULLJSON_HPP__
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cmath>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#if __cplusplus >= 202002L && __has_include(<coroutine>)
+#include <coroutine>
+#define DULL_HAVE_COROUTINE
+#endif
+#include "dulljson.h"
+
+/*
+ * header-only C++17 layer over dulljson.h.
+ * value is a non-owning view and const_value its read-only twin,
+ * document owns a tree and is move-only.
+ * nothing here copies strings or allocates beyond what the C API does.
+ */
+namespace dull {
+
+enum class type {
+    null = DULL_NULL, false_ = DULL_FALSE, true_ = DULL_TRUE,
+    number = DULL_NUMBER, string = DULL_STRING, array = DULL_ARRAY, object = DULL_OBJECT
+};
+
+template <class T> struct dependent_false : std::false_type {};
+
+namespace detail {
+
+/* whether n converts to T without undefined behaviour or a silent change */
+template <class T>
+bool fits(double n) {
+    if constexpr (std::is_integral_v<T>) {
+        /* both bounds are powers of two, so they are exact as doubles */
+        const double hi = std::ldexp(1.0, std::numeric_limits<T>::digits);
+        const double lo = std::is_signed_v<T> ? -hi : 0.0;
+        return n >= lo && n < hi && std::trunc(n) == n;
+    }
+    else
+        return std::fabs(n) <= static_cast<double>(std::numeric_limits<T>::max());
+}
+
+} // namespace detail
+
+/* V is dull_value for a view that may be handed to mutating C calls, const dull_value for a read-only one */
+template <class V> class basic_value;
+template <class V> struct basic_member;
+
+/* the member type that goes with V */
+template <class V>
+using member_of = std::conditional_t<std::is_const_v<V>, const dull_member, dull_member>;
+
+template <class V>
+class basic_array_iterator {
+public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = basic_value<V>;
+    using difference_type = std::ptrdiff_t;
+    using reference = basic_value<V>;
+    using pointer = void;
+
+    basic_array_iterator() : e_(nullptr) {}
+    explicit basic_array_iterator(V* e) : e_(e) {}
+
+    inline basic_value<V> operator*() const;
+    inline basic_value<V> operator[](difference_type n) const;
+
+    basic_array_iterator& operator++() { ++e_; return *this; }
+    basic_array_iterator operator++(int) { basic_array_iterator t(*this); ++e_; return t; }
+    basic_array_iterator& operator--() { --e_; return *this; }
+    basic_array_iterator operator--(int) { basic_array_iterator t(*this); --e_; return t; }
+    basic_array_iterator& operator+=(difference_type n) { e_ += n; return *this; }
+    basic_array_iterator& operator-=(difference_type n) { e_ -= n; return *this; }
+    basic_array_iterator operator+(difference_type n) const { return basic_array_iterator(e_ + n); }
+    basic_array_iterator operator-(difference_type n) const { return basic_array_iterator(e_ - n); }
+    friend basic_array_iterator operator+(difference_type n, basic_array_iterator it) { return it + n; }
+    difference_type operator-(basic_array_iterator rhs) const { return e_ - rhs.e_; }
+
+    bool operator==(basic_array_iterator rhs) const { return e_ == rhs.e_; }
+    bool operator!=(basic_array_iterator rhs) const { return e_ != rhs.e_; }
+    bool operator<(basic_array_iterator rhs) const { return e_ < rhs.e_; }
+    bool operator>(basic_array_iterator rhs) const { return e_ > rhs.e_; }
+    bool operator<=(basic_array_iterator rhs) const { return e_ <= rhs.e_; }
+    bool operator>=(basic_array_iterator rhs) const { return e_ >= rhs.e_; }
+
+private:
+    V* e_;
+};
+
+template <class V>
+class basic_member_iterator {
+public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = basic_member<V>;
+    using difference_type = std::ptrdiff_t;
+    using reference = basic_member<V>;
+    using pointer = void;
+
+    basic_member_iterator() : m_(nullptr) {}
+    explicit basic_member_iterator(member_of<V>* m) : m_(m) {}
+
+    inline basic_member<V> operator*() const;
+    inline basic_member<V> operator[](difference_type n) const;
+
+    basic_member_iterator& operator++() { ++m_; return *this; }
+    basic_member_iterator operator++(int) { basic_member_iterator t(*this); ++m_; return t; }
+    basic_member_iterator& operator--() { --m_; return *this; }
+    basic_member_iterator operator--(int) { basic_member_iterator t(*this); --m_; return t; }
+    basic_member_iterator& operator+=(difference_type n) { m_ += n; return *this; }
+    basic_member_iterator& operator-=(difference_type n) { m_ -= n; return *this; }
+    basic_member_iterator operator+(difference_type n) const { return basic_member_iterator(m_ + n); }
+    basic_member_iterator operator-(difference_type n) const { return basic_member_iterator(m_ - n); }
+    friend basic_member_iterator operator+(difference_type n, basic_member_iterator it) { return it + n; }
+    difference_type operator-(basic_member_iterator rhs) const { return m_ - rhs.m_; }
+
+    bool operator==(basic_member_iterator rhs) const { return m_ == rhs.m_; }
+    bool operator!=(basic_member_iterator rhs) const { return m_ != rhs.m_; }
+    bool operator<(basic_member_iterator rhs) const { return m_ < rhs.m_; }
+    bool operator>(basic_member_iterator rhs) const { return m_ > rhs.m_; }
+    bool operator<=(basic_member_iterator rhs) const { return m_ <= rhs.m_; }
+    bool operator>=(basic_member_iterator rhs) const { return m_ >= rhs.m_; }
+
+private:
+    member_of<V>* m_;
+};
+
+template <class It>
+class range {
+public:
+    range(It first, It last) : first_(first), last_(last) {}
+    It begin() const { return first_; }
+    It end() const { return last_; }
+    std::size_t size() const { return static_cast<std::size_t>(last_ - first_); }
+private:
+    It first_, last_;
+};
+
+template <class V>
+class basic_value {
+public:
+    basic_value() : v_(nullptr) {}
+    basic_value(V* v) : v_(v) {}
+
+    /* a mutable view converts to a read-only one, never the other way */
+    template <class U, class = std::enable_if_t<std::is_same_v<const U, V> && !std::is_same_v<U, V>>>
+    basic_value(basic_value<U> rhs) : v_(rhs.raw()) {}
+
+    explicit operator bool() const { return v_ != nullptr; }
+    V* raw() const { return v_; }
+
+    dull::type type() const { return static_cast<dull::type>(dull_get_type(v_)); }
+    bool is_null() const { return v_->type == DULL_NULL; }
+    bool is_bool() const { return v_->type == DULL_TRUE || v_->type == DULL_FALSE; }
+    bool is_number() const { return v_->type == DULL_NUMBER; }
+    bool is_string() const { return v_->type == DULL_STRING; }
+    bool is_array() const { return v_->type == DULL_ARRAY; }
+    bool is_object() const { return v_->type == DULL_OBJECT; }
+
+    /* bool, any arithmetic type, std::string_view, const char* or std::string */
+    template <class T>
+    T get() const {
+        if constexpr (std::is_same_v<T, bool>)
+            return dull_get_boolean(v_) != 0;
+        else if constexpr (std::is_arithmetic_v<T>) {
+            double n = dull_get_number(v_);
+            /* out of range is undefined behaviour, get(T&) reports it instead */
+            assert(detail::fits<T>(n));
+            return static_cast<T>(n);
+        }
+        else if constexpr (std::is_same_v<T, std::string_view>) {
+            assert(is_string());
+            return std::string_view(v_->u.s.s, v_->u.s.len);
+        }
+        else if constexpr (std::is_same_v<T, const char*>)
+            return dull_get_string(v_);
+        else if constexpr (std::is_same_v<T, std::string>) {
+            assert(is_string());
+            return std::string(v_->u.s.s, v_->u.s.len);
+        }
+        else
+            static_assert(dependent_false<T>::value, "unsupported type for dull::value::get");
+    }
+
+    /* the checked form of get<T>(): DULL_PARSE_TYPE_MISMATCH when v isn't a T, like from_json */
+    template <class T>
+    int get(T& out) const {
+        bool ok;
+        if constexpr (std::is_same_v<T, bool>)
+            ok = is_bool();
+        else if constexpr (std::is_arithmetic_v<T>)
+            ok = is_number() && detail::fits<T>(v_->u.n);
+        else
+            ok = is_string();
+        if (!ok)
+            return DULL_PARSE_TYPE_MISMATCH;
+        out = get<T>();
+        return DULL_PARSE_OK;
+    }
+
+    /* elements for arrays, members for objects */
+    std::size_t size() const {
+        assert(is_array() || is_object());
+        return is_array() ? v_->u.a.size : v_->u.o.size;
+    }
+
+    basic_value operator[](std::size_t index) const {
+        assert(is_array() && index < v_->u.a.size);
+        return basic_value(&v_->u.a.e[index]);
+    }
+
+    /* an empty value when the key is missing */
+    basic_value operator[](std::string_view key) const {
+        std::size_t index = dull_find_object_index(v_, key.data(), key.size());
+        return index != DULL_KEY_NOT_EXIST ? basic_value(&v_->u.o.m[index].v) : basic_value();
+    }
+
+    basic_array_iterator<V> begin() const {
+        assert(is_array());
+        return basic_array_iterator<V>(v_->u.a.e);
+    }
+
+    basic_array_iterator<V> end() const {
+        assert(is_array());
+        return basic_array_iterator<V>(v_->u.a.e + v_->u.a.size);
+    }
+
+    range<basic_member_iterator<V>> members() const {
+        assert(is_object());
+        return range<basic_member_iterator<V>>(basic_member_iterator<V>(v_->u.o.m),
+            basic_member_iterator<V>(v_->u.o.m + v_->u.o.size));
+    }
+
+protected:
+    V* v_;
+};
+
+template <class V>
+struct basic_member {
+    std::string_view key;
+    basic_value<V> value;
+};
+
+using value = basic_value<dull_value>;
+using const_value = basic_value<const dull_value>;
+using member = basic_member<dull_value>;
+using const_member = basic_member<const dull_value>;
+using array_iterator = basic_array_iterator<dull_value>;
+using member_iterator = basic_member_iterator<dull_value>;
+
+template <class V>
+basic_value<V> basic_array_iterator<V>::operator*() const { return basic_value<V>(e_); }
+template <class V>
+basic_value<V> basic_array_iterator<V>::operator[](difference_type n) const { return basic_value<V>(e_ + n); }
+template <class V>
+basic_member<V> basic_member_iterator<V>::operator*() const {
+    return basic_member<V>{ std::string_view(m_->k, m_->klen), basic_value<V>(&m_->v) };
+}
+template <class V>
+basic_member<V> basic_member_iterator<V>::operator[](difference_type n) const { return *(*this + n); }
+
+/* owns one tree, released with dull_free() */
+class document {
+public:
+    document() { DULL_INIT(&root_); }
+    ~document() { dull_free(&root_); }
+
+    document(const document&) = delete;
+    document& operator=(const document&) = delete;
+
+    document(document&& rhs) noexcept {
+        DULL_INIT(&root_);
+        dull_move(&root_, &rhs.root_);
+    }
+
+    document& operator=(document&& rhs) noexcept {
+        if (this != &rhs)
+            dull_move(&root_, &rhs.root_);
+        return *this;
+    }
+
+    /* deep copies are explicit and go through dull_copy()'s single block */
+    document copy() const {
+        document d;
+        dull_copy(&d.root_, &root_);
+        return d;
+    }
+
+    /* the C parsers overwrite their target, so the old tree is released first */
+    int parse(const char* json) { dull_free(&root_); return dull_parse(&root_, json); }
+    int parse(const std::string& json) { return parse(json.c_str()); }
+    int parse(const char* json, dull_parse_result& r) { dull_free(&root_); return dull_parse_ex(&root_, json, &r); }
+    int parse_file(const char* path, int flags = 0) { dull_free(&root_); return dull_parse_file(&root_, path, flags); }
+
+    dull::value root() { return dull::value(&root_); }
+    dull::const_value root() const { return dull::const_value(&root_); }
+    dull_value* raw() { return &root_; }
+    const dull_value* raw() const { return &root_; }
+
+    void swap(document& rhs) { dull_swap(&root_, &rhs.root_); }
+
+private:
+    dull_value root_;
+};
+
+#ifdef DULL_HAVE_COROUTINE
+/*
+ * a parse that gives control back to an event loop between slices:
+ *
+ *     dull::async_parse parse(json, 64 * 1024);
+ *     int ret;
+ *     while ((ret = co_await parse.step(schedule)) == DULL_PARSE_PENDING);
+ *     dull::document d = parse.take();
+ *
+ * each co_await runs one slice of budget bytes and, unless that finished the
+ * parse, suspends with schedule(handle) so the loop can resume it later.
+ * json must outlive the parse.
+ */
+class async_parse {
+public:
+    async_parse(const char* json, size_t budget)
+        : p_(dull_async_parse_begin(doc_.raw(), json)), budget_(budget), code_(DULL_PARSE_PENDING), result_() {}
+    ~async_parse() { if (p_) dull_async_parse_end(p_, nullptr); }
+
+    /* the parser writes into doc_, so it can't move */
+    async_parse(const async_parse&) = delete;
+    async_parse& operator=(const async_parse&) = delete;
+
+    /* runs one slice without suspending */
+    int poll() {
+        if (p_ && (code_ = dull_async_parse_step(p_, budget_)) != DULL_PARSE_PENDING) {
+            dull_async_parse_end(p_, &result_);
+            p_ = nullptr;
+        }
+        return code_;
+    }
+
+    template <class Schedule>
+    struct awaiter {
+        async_parse* parse;
+        Schedule schedule;
+        int code;
+
+        bool await_ready() { return (code = parse->poll()) != DULL_PARSE_PENDING; }
+        void await_suspend(std::coroutine_handle<> h) { schedule(h); }
+        int await_resume() const { return code; }
+    };
+
+    template <class Schedule>
+    awaiter<std::decay_t<Schedule>> step(Schedule&& schedule) {
+        return { this, std::forward<Schedule>(schedule), DULL_PARSE_PENDING };
+    }
+
+    bool done() const { return code_ != DULL_PARSE_PENDING; }
+    const dull_parse_result& result() const { return result_; }
+    document take() { return std::move(doc_); }
+
+private:
+    document doc_;
+    dull_async_parser* p_;
+    size_t budget_;
+    int code_;
+    dull_parse_result result_;
+};
+#endif
+
+/* a frozen document; copies share it through the atomic reference count */
+class shared_document {
+public:
+    shared_document() : d_(nullptr) {}
+    explicit shared_document(document&& doc) : d_(dull_freeze(doc.raw())) {}
+    ~shared_document() { dull_document_release(d_); }
+
+    shared_document(const shared_document& rhs) : d_(rhs.d_ ? dull_document_retain(rhs.d_) : nullptr) {}
+    shared_document(shared_document&& rhs) noexcept : d_(rhs.d_) { rhs.d_ = nullptr; }
+
+    shared_document& operator=(shared_document rhs) noexcept {
+        std::swap(d_, rhs.d_);
+        return *this;
+    }
+
+    explicit operator bool() const { return d_ != nullptr; }
+
+    /* other threads may be reading the same tree, so it is only handed out read-only */
+    dull::const_value root() const { return dull::const_value(dull_document_root(d_)); }
+
+    /* indexed lookup, safe from any thread; object must come from this document */
+    dull::const_value find(dull::const_value object, std::string_view key) const {
+        return dull::const_value(dull_document_find(d_, object.raw(), key.data(), key.size()));
+    }
+
+private:
+    dull_document* d_;
+};
+
+/*
+ * typed deserialization straight from the input, without dull_value nodes.
+ * a struct lists its JSON fields once:
+ *
+ *     struct point { double x, y; std::string label; };
+ *     DULL_FIELDS(point, DULL_FIELD(point, x), DULL_FIELD(point, y), DULL_FIELD(point, label));
+ *
+ * and dull::from_json(json, p) fills it. keys are matched through a perfect
+ * hash table built at compile time; unknown keys are validated and skipped.
+ * supported members: bool, arithmetic types, std::string, std::vector and
+ * other described structs.
+ */
+
+template <class C, class M>
+struct field_t {
+    std::string_view name;
+    M C::* ptr;
+};
+
+template <class C, class M>
+constexpr field_t<C, M> field(std::string_view name, M C::* ptr) { return field_t<C, M>{ name, ptr }; }
+
+/* specialized with a `static constexpr auto value` tuple of field()s, see DULL_FIELDS */
+template <class T> struct fields;
+
+#define DULL_FIELD(type, name) ::dull::field(#name, &type::name)
+#define DULL_FIELDS(type, ...) \
+    template <> struct dull::fields<type> { static constexpr auto value = std::make_tuple(__VA_ARGS__); }
+
+namespace detail {
+
+constexpr std::uint32_t key_hash(const char* s, std::size_t len, std::uint32_t seed) {
+    std::uint32_t h = 2166136261u ^ seed;
+    for (std::size_t i = 0; i < len; i++) {
+        h ^= static_cast<unsigned char>(s[i]);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/* bails out after this many seeds per table size and doubles the table */
+constexpr std::uint32_t key_seed_tries = 64;
+
+template <std::size_t N>
+constexpr bool key_seed_works(const std::array<std::string_view, N>& keys, std::size_t size, std::uint32_t seed) {
+    bool used[N * 64 + 2] = {};
+    for (std::size_t i = 0; i < N; i++) {
+        std::size_t slot = key_hash(keys[i].data(), keys[i].size(), seed) & (size - 1);
+        if (used[slot])
+            return false;
+        used[slot] = true;
+    }
+    return true;
+}
+
+/* smallest power-of-two table some seed hashes the keys into without collisions, 0 on duplicate keys */
+template <std::size_t N>
+constexpr std::size_t key_table_size(const std::array<std::string_view, N>& keys) {
+    for (std::size_t i = 0; i < N; i++)
+        for (std::size_t j = i + 1; j < N; j++)
+            if (keys[i] == keys[j])
+                return 0;
+    std::size_t size = 2;
+    while (size < N * 2)
+        size *= 2;
+    for (; size <= N * 64 || size <= 2; size *= 2)
+        for (std::uint32_t seed = 0; seed < key_seed_tries; seed++)
+            if (key_seed_works(keys, size, seed))
+                return size;
+    return 0;
+}
+
+template <std::size_t N, std::size_t Size>
+struct key_table {
+    std::array<std::string_view, N> keys;
+    std::uint32_t seed;
+    std::uint8_t slots[Size];  /* field index + 1, 0 when empty */
+
+    constexpr int find(const char* s, std::size_t len) const {
+        int i = slots[key_hash(s, len, seed) & (Size - 1)] - 1;
+        if (i < 0 || keys[i].size() != len || std::char_traits<char>::compare(keys[i].data(), s, len) != 0)
+            return -1;
+        return i;
+    }
+};
+
+template <std::size_t Size, std::size_t N>
+constexpr key_table<N, Size> make_key_table(const std::array<std::string_view, N>& keys) {
+    key_table<N, Size> t{ keys, 0, {} };
+    while (!key_seed_works(keys, Size, t.seed))
+        t.seed++;
+    for (std::size_t i = 0; i < N; i++)
+        t.slots[key_hash(keys[i].data(), keys[i].size(), t.seed) & (Size - 1)] = static_cast<std::uint8_t>(i + 1);
+    return t;
+}
+
+template <class T, std::size_t... I>
+constexpr std::array<std::string_view, sizeof...(I)> field_names(std::index_sequence<I...>) {
+    return {{ std::get<I>(fields<T>::value).name... }};
+}
+
+template <class T>
+struct field_count : std::tuple_size<std::decay_t<decltype(fields<T>::value)>> {};
+
+template <class T>
+struct keys_of {
+    static constexpr auto names = field_names<T>(std::make_index_sequence<field_count<T>::value>());
+    static constexpr std::size_t size = key_table_size(names);
+    static_assert(field_count<T>::value < 255, "too many fields");
+    static_assert(size != 0, "duplicate JSON field names or no perfect hash found");
+    static constexpr auto table = make_key_table<size>(names);
+};
+
+template <class T, class = void> struct is_described : std::false_type {};
+template <class T> struct is_described<T, std::void_t<decltype(fields<T>::value)>> : std::true_type {};
+
+template <class T> struct is_vector : std::false_type {};
+template <class T, class A> struct is_vector<std::vector<T, A>> : std::true_type {};
+
+template <class T> int read(dull_reader* r, T& out);
+
+template <class T, std::size_t... I>
+int read_field(dull_reader* r, T& out, int index, std::index_sequence<I...>) {
+    int ret = DULL_PARSE_OK;
+    ((index == static_cast<int>(I) ? (void)(ret = read(r, out.*(std::get<I>(fields<T>::value).ptr))) : (void)0), ...);
+    return ret;
+}
+
+inline int enter(dull_reader* r, char ch) {
+    char next = dull_reader_peek(r);
+    if (next != ch)
+        return next == '\0' ? DULL_PARSE_EXPECT_VALUE : DULL_PARSE_TYPE_MISMATCH;
+    r->json++;
+    return DULL_PARSE_OK;
+}
+
+template <class T>
+int read_object(dull_reader* r, T& out) {
+    int ret;
+    if ((ret = enter(r, '{')) != DULL_PARSE_OK)
+        return ret;
+    if (dull_reader_peek(r) == '}') {
+        r->json++;
+        return DULL_PARSE_OK;
+    }
+    for (;;) {
+        const char* k;
+        std::size_t klen;
+        if (dull_reader_peek(r) != '"')
+            return DULL_PARSE_MISS_KEY;
+        if ((ret = dull_reader_string(r, &k, &klen)) != DULL_PARSE_OK)
+            return ret;
+        /* k only lives until the next scanner call, so it is matched right away */
+        int index = keys_of<T>::table.find(k, klen);
+        if (dull_reader_peek(r) != ':')
+            return DULL_PARSE_MISS_COLON;
+        r->json++;
+        ret = index < 0 ? dull_reader_skip(r)
+            : read_field(r, out, index, std::make_index_sequence<field_count<T>::value>());
+        if (ret != DULL_PARSE_OK)
+            return ret;
+        switch (dull_reader_peek(r)) {
+            case ',': r->json++; break;
+            case '}': r->json++; return DULL_PARSE_OK;
+            default: return DULL_PARSE_MISS_COMMA_OR_CURLY_BRACKET;
+        }
+    }
+}
+
+template <class T>
+int read_array(dull_reader* r, std::vector<T>& out) {
+    int ret;
+    if ((ret = enter(r, '[')) != DULL_PARSE_OK)
+        return ret;
+    out.clear();
+    if (dull_reader_peek(r) == ']') {
+        r->json++;
+        return DULL_PARSE_OK;
+    }
+    for (;;) {
+        if constexpr (std::is_same_v<T, bool>) {
+            /* std::vector<bool> hands out proxies, not bool& */
+            bool b;
+            if ((ret = read(r, b)) != DULL_PARSE_OK)
+                return ret;
+            out.push_back(b);
+        }
+        else {
+            out.emplace_back();
+            if ((ret = read(r, out.back())) != DULL_PARSE_OK)
+                return ret;
+        }
+        switch (dull_reader_peek(r)) {
+            case ',': r->json++; break;
+            case ']': r->json++; return DULL_PARSE_OK;
+            default: return DULL_PARSE_MISS_COMMA_OR_SQUARE_BRACKET;
+        }
+    }
+}
+
+template <class T>
+int read(dull_reader* r, T& out) {
+    int ret;
+    if constexpr (std::is_same_v<T, bool>) {
+        int b;
+        if ((ret = dull_reader_boolean(r, &b)) == DULL_PARSE_OK)
+            out = b != 0;
+        return ret;
+    }
+    else if constexpr (std::is_arithmetic_v<T>) {
+        double n;
+        if ((ret = dull_reader_number(r, &n)) != DULL_PARSE_OK)
+            return ret;
+        if (!fits<T>(n))
+            return DULL_PARSE_TYPE_MISMATCH;
+        out = static_cast<T>(n);
+        return DULL_PARSE_OK;
+    }
+    else if constexpr (std::is_same_v<T, std::string>) {
+        const char* s;
+        std::size_t len;
+        if ((ret = dull_reader_string(r, &s, &len)) == DULL_PARSE_OK)
+            out.assign(s, len);
+        return ret;
+    }
+    else if constexpr (is_vector<T>::value)
+        return read_array(r, out);
+    else if constexpr (is_described<T>::value)
+        return read_object(r, out);
+    else
+        static_assert(dependent_false<T>::value, "no JSON mapping for this type, describe it with DULL_FIELDS");
+}
+
+} // namespace detail
+
+/* fields missing from the input keep their values */
+template <class T>
+int from_json(const char* json, T& out) {
+    dull_reader r;
+    dull_reader_init(&r, json);
+    int ret = detail::read(&r, out);
+    if (ret == DULL_PARSE_OK && dull_reader_peek(&r) != '\0')
+        ret = DULL_PARSE_ROOT_NOT_SINGULAR;
+    dull_reader_free(&r);
+    return ret;
+}
+
+} // namespace dull
+
+#endif /* DULLJSON_HPP__ */
@@ -5,6 +5,12 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
+#if defined(__unix__) || defined(__APPLE__)
+#include <pthread.h>
+#include <unistd.h>
+#define TEST_THREADS
+#endif
 #include "dulljson.h"
 
 static int main_ret = 0;
@@ -345,6 +351,135 @@ static void test_parse_miss_comma_or_curly_bracket() {
     TEST_ERROR(DULL_PARSE_MISS_COMMA_OR_CURLY_BRACKET, "{\"a\":{}");
 }
 
+#define TEST_ERROR_POSITION(error, eoffset, eline, ecolumn, json)\
+    do {\
+        dull_value v;\
+        dull_parse_result r;\
+        DULL_INIT(&v);\
+        EXPECT_EQ_INT(error, dull_parse_ex(&v, json, &r));\
+        EXPECT_EQ_INT(error, r.code);\
+        EXPECT_EQ_SIZE_T(eoffset, r.offset);\
+        EXPECT_EQ_SIZE_T(eline, r.line);\
+        EXPECT_EQ_SIZE_T(ecolumn, r.column);\
+        dull_free(&v);\
+    } while(0)
+
+static void test_parse_error_position() {
+    TEST_ERROR_POSITION(DULL_PARSE_OK, 0, 0, 0, " [ 1, 2 ] ");
+    TEST_ERROR_POSITION(DULL_PARSE_EXPECT_VALUE, 2, 1, 3, "  ");
+    TEST_ERROR_POSITION(DULL_PARSE_INVALID_VALUE, 4, 1, 5, "[1, nul]");
+    TEST_ERROR_POSITION(DULL_PARSE_ROOT_NOT_SINGULAR, 5, 1, 6, "null x");
+    TEST_ERROR_POSITION(DULL_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, 9, 3, 4, "[\n 1,\n 2 3]");
+    TEST_ERROR_POSITION(DULL_PARSE_MISS_COMMA_OR_CURLY_BRACKET, 13, 2, 8, "{\"a\":\n{\"b\":1 \"c\"}}");
+    TEST_ERROR_POSITION(DULL_PARSE_INVALID_STRING_ESCAPE, 8, 2, 3, "[\"a\",\n\"b\\v\"]");
+    TEST_ERROR_POSITION(DULL_PARSE_MISS_QUOTATION_MARK, 4, 1, 5, "\"abc");
+}
+
+static void test_write_file(const char* path, const char* json, size_t len) {
+    FILE* fp = fopen(path, "wb");
+    fwrite(json, 1, len, fp);
+    fclose(fp);
+}
+
+static void test_parse_file() {
+    const char* path = "dull_test_parse_file.json";
+    const char json[] = "{\"a\":[1,true,\"abc\"]}";
+    char page[4096];
+    dull_value v;
+    dull_parse_result r;
+
+    DULL_INIT(&v);
+    test_write_file(path, json, sizeof(json) - 1);
+    EXPECT_EQ_INT(DULL_PARSE_OK, dull_parse_file(&v, path, 0));
+    EXPECT_EQ_SIZE_T(3, dull_get_array_size(dull_find_object_value(&v, "a", 1)));
+    dull_free(&v);
+
+    /* a file filling whole pages still reads as terminated */
+    memset(page, ' ', sizeof(page));
+    page[0] = '[';
+    page[sizeof(page) - 1] = ']';
+    test_write_file(path, page, sizeof(page));
+    EXPECT_EQ_INT(DULL_PARSE_OK, dull_parse_file(&v, path, DULL_FILE_POPULATE));
+    EXPECT_EQ_SIZE_T(0, dull_get_array_size(&v));
+    dull_free(&v);
+
+    test_write_file(path, "", 0);
+    EXPECT_EQ_INT(DULL_PARSE_EXPECT_VALUE, dull_parse_file(&v, path, 0));
+
+    test_write_file(path, "[1]\0[2]", 7);
+    EXPECT_EQ_INT(DULL_PARSE_ROOT_NOT_SINGULAR, dull_parse_file_ex(&v, path, 0, &r));
+    EXPECT_EQ_SIZE_T(3, r.offset);
+    EXPECT_EQ_INT(DULL_NULL, dull_get_type(&v));
+
+#ifdef __linux__
+    /* a pipe has no size to map, so it is read to the end instead */
+    {
+        int fds[2];
+        char fd_path[64];
+        if (pipe(fds) == 0) {
+            EXPECT_TRUE(write(fds[1], json, sizeof(json) - 1) == (ssize_t)(sizeof(json) - 1));
+            close(fds[1]);
+            sprintf(fd_path, "/proc/self/fd/%d", fds[0]);
+            EXPECT_EQ_INT(DULL_PARSE_OK, dull_parse_file(&v, fd_path, 0));
+            EXPECT_EQ_SIZE_T(3, dull_get_array_size(dull_find_object_value(&v, "a", 1)));
+            dull_free(&v);
+            close(fds[0]);
+        }
+        /* longer than the first read buffer */
+        if (pipe(fds) == 0) {
+            char big[10000];
+            memset(big, ' ', sizeof(big));
+            big[0] = '[';
+            big[sizeof(big) - 1] = ']';
+            EXPECT_TRUE(write(fds[1], big, sizeof(big)) == (ssize_t)sizeof(big));
+            close(fds[1]);
+            sprintf(fd_path, "/proc/self/fd/%d", fds[0]);
+            EXPECT_EQ_INT(DULL_PARSE_OK, dull_parse_file(&v, fd_path, 0));
+            EXPECT_EQ_INT(DULL_ARRAY, dull_get_type(&v));
+            dull_free(&v);
+            close(fds[0]);
+        }
+    }
+#endif
+
+    remove(path);
+    EXPECT_EQ_INT(DULL_PARSE_FILE_ERROR, dull_parse_file(&v, path, 0));
+    memset(&r, 0x5A, sizeof(r));
+    EXPECT_EQ_INT(DULL_PARSE_FILE_ERROR, dull_parse_file_ex(&v, path, 0, &r));
+    EXPECT_EQ_INT(DULL_PARSE_FILE_ERROR, r.code);
+    EXPECT_EQ_SIZE_T(0, r.offset);
+    EXPECT_EQ_SIZE_T(0, r.line);
+    EXPECT_EQ_SIZE_T(0, r.column);
+}
+
+static void test_parse_stats() {
+    dull_value v;
+    dull_parse_stats s;
+    DULL_INIT(&v);
+    EXPECT_EQ_INT(DULL_PARSE_OK, dull_parse_stats_ex(&v,
+        "{\"a\":[1,2,[null,true,false]],\"s\":\"x\\ny\\u00A2\",\"o\":{}}", &s));
+#ifdef DULL_PARSE_STATS
+    EXPECT_EQ_SIZE_T(1, s.nodes[DULL_NULL]);
+    EXPECT_EQ_SIZE_T(1, s.nodes[DULL_TRUE]);
+    EXPECT_EQ_SIZE_T(1, s.nodes[DULL_FALSE]);
+    EXPECT_EQ_SIZE_T(2, s.nodes[DULL_NUMBER]);
+    EXPECT_EQ_SIZE_T(1, s.nodes[DULL_STRING]);
+    EXPECT_EQ_SIZE_T(2, s.nodes[DULL_ARRAY]);
+    EXPECT_EQ_SIZE_T(2, s.nodes[DULL_OBJECT]);
+    EXPECT_EQ_SIZE_T(8, s.string_bytes); /* "a", "s", "o" and the 5 decoded bytes */
+    EXPECT_EQ_SIZE_T(2, s.escapes);
+    EXPECT_EQ_SIZE_T(7, s.heap_allocs);  /* 3 keys, 1 string, 2 element arrays, 1 member array */
+    EXPECT_EQ_SIZE_T(1, s.stack_allocs);
+    EXPECT_EQ_SIZE_T(0, s.stack_reallocs);
+    EXPECT_EQ_SIZE_T(3, s.max_depth);
+    EXPECT_TRUE(s.total_ns >= s.string_ns + s.number_ns);
+#else
+    EXPECT_EQ_SIZE_T(0, s.nodes[DULL_OBJECT]);
+    EXPECT_EQ_SIZE_T(0, s.max_depth);
+#endif
+    dull_free(&v);
+}
+
 static void test_parse() {
     test_parse_null();
     test_parse_true();
@@ -367,6 +502,9 @@ static void test_parse() {
     test_parse_miss_key();
     test_parse_miss_colon();
     test_parse_miss_comma_or_curly_bracket();
+    test_parse_error_position();
+    test_parse_file();
+    test_parse_stats();
 }
 
 static void test_access_null() {
@@ -408,11 +546,951 @@ static void test_access_string() {
     dull_free(&v);
 }
 
+static void test_access_array() {
+    dull_value a, e;
+    size_t i, j;
+
+    DULL_INIT(&a);
+
+    for (j = 0; j <= 5; j += 5) {
+        dull_set_array(&a, j);
+        EXPECT_EQ_SIZE_T(0, dull_get_array_size(&a));
+        EXPECT_EQ_SIZE_T(j, dull_get_array_capacity(&a));
+        for (i = 0; i < 10; i++) {
+            DULL_INIT(&e);
+            dull_set_number(&e, i);
+            dull_move(dull_pushback_array_element(&a), &e);
+            dull_free(&e);
+        }
+
+        EXPECT_EQ_SIZE_T(10, dull_get_array_size(&a));
+        for (i = 0; i < 10; i++)
+            EXPECT_EQ_DOUBLE((double)i, dull_get_number(dull_get_array_element(&a, i)));
+    }
+
+    dull_popback_array_element(&a);
+    EXPECT_EQ_SIZE_T(9, dull_get_array_size(&a));
+    for (i = 0; i < 9; i++)
+        EXPECT_EQ_DOUBLE((double)i, dull_get_number(dull_get_array_element(&a, i)));
+
+    dull_remove_array_element(&a, 4, 0);
+    EXPECT_EQ_SIZE_T(9, dull_get_array_size(&a));
+    for (i = 0; i < 9; i++)
+        EXPECT_EQ_DOUBLE((double)i, dull_get_number(dull_get_array_element(&a, i)));
+
+    dull_remove_array_element(&a, 8, 1);
+    EXPECT_EQ_SIZE_T(8, dull_get_array_size(&a));
+    for (i = 0; i < 8; i++)
+        EXPECT_EQ_DOUBLE((double)i, dull_get_number(dull_get_array_element(&a, i)));
+
+    dull_remove_array_element(&a, 0, 2);
+    EXPECT_EQ_SIZE_T(6, dull_get_array_size(&a));
+    for (i = 0; i < 6; i++)
+        EXPECT_EQ_DOUBLE((double)i + 2, dull_get_number(dull_get_array_element(&a, i)));
+
+    for (i = 0; i < 2; i++) {
+        DULL_INIT(&e);
+        dull_set_number(&e, i);
+        dull_move(dull_insert_array_element(&a, i), &e);
+        dull_free(&e);
+    }
+
+    EXPECT_EQ_SIZE_T(8, dull_get_array_size(&a));
+    for (i = 0; i < 8; i++)
+        EXPECT_EQ_DOUBLE((double)i, dull_get_number(dull_get_array_element(&a, i)));
+
+    EXPECT_TRUE(dull_get_array_capacity(&a) > 8);
+    dull_shrink_array(&a);
+    EXPECT_EQ_SIZE_T(8, dull_get_array_capacity(&a));
+    EXPECT_EQ_SIZE_T(8, dull_get_array_size(&a));
+    for (i = 0; i < 8; i++)
+        EXPECT_EQ_DOUBLE((double)i, dull_get_number(dull_get_array_element(&a, i)));
+
+    DULL_INIT(&e);
+    dull_set_string(&e, "Hello", 5);
+    dull_move(dull_pushback_array_element(&a), &e);
+    dull_free(&e);
+
+    i = dull_get_array_capacity(&a);
+    dull_clear_array(&a);
+    EXPECT_EQ_SIZE_T(0, dull_get_array_size(&a));
+    EXPECT_EQ_SIZE_T(i, dull_get_array_capacity(&a));
+    dull_shrink_array(&a);
+    EXPECT_EQ_SIZE_T(0, dull_get_array_capacity(&a));
+
+    dull_free(&a);
+}
+
+static void test_access_object() {
+    dull_value o, v, *pv;
+    size_t i, j, index;
+
+    DULL_INIT(&o);
+
+    for (j = 0; j <= 5; j += 5) {
+        dull_set_object(&o, j);
+        EXPECT_EQ_SIZE_T(0, dull_get_object_size(&o));
+        EXPECT_EQ_SIZE_T(j, dull_get_object_capacity(&o));
+        for (i = 0; i < 10; i++) {
+            char key[2] = "a";
+            key[0] += i;
+            DULL_INIT(&v);
+            dull_set_number(&v, i);
+            dull_move(dull_set_object_value(&o, key, 1), &v);
+            dull_free(&v);
+        }
+        EXPECT_EQ_SIZE_T(10, dull_get_object_size(&o));
+        for (i = 0; i < 10; i++) {
+            char key[] = "a";
+            key[0] += i;
+            index = dull_find_object_index(&o, key, 1);
+            EXPECT_TRUE(index != DULL_KEY_NOT_EXIST);
+            pv = dull_get_object_value(&o, index);
+            EXPECT_EQ_DOUBLE((double)i, dull_get_number(pv));
+        }
+    }
+
+    index = dull_find_object_index(&o, "j", 1);
+    EXPECT_TRUE(index != DULL_KEY_NOT_EXIST);
+    dull_remove_object_value(&o, index);
+    index = dull_find_object_index(&o, "j", 1);
+    EXPECT_TRUE(index == DULL_KEY_NOT_EXIST);
+    EXPECT_EQ_SIZE_T(9, dull_get_object_size(&o));
+
+    index = dull_find_object_index(&o, "a", 1);
+    EXPECT_TRUE(index != DULL_KEY_NOT_EXIST);
+    dull_remove_object_value(&o, index);
+    index = dull_find_object_index(&o, "a", 1);
+    EXPECT_TRUE(index == DULL_KEY_NOT_EXIST);
+    EXPECT_EQ_SIZE_T(8, dull_get_object_size(&o));
+
+    EXPECT_TRUE(dull_get_object_capacity(&o) > 8);
+    dull_shrink_object(&o);
+    EXPECT_EQ_SIZE_T(8, dull_get_object_capacity(&o));
+    EXPECT_EQ_SIZE_T(8, dull_get_object_size(&o));
+    for (i = 0; i < 8; i++) {
+        char key[] = "a";
+        key[0] += i + 1;
+        EXPECT_EQ_DOUBLE((double)i + 1, dull_get_number(dull_get_object_value(&o, dull_find_object_index(&o, key, 1))));
+    }
+
+    DULL_INIT(&v);
+    dull_set_string(&v, "Hello", 5);
+    dull_move(dull_set_object_value(&o, "World", 5), &v);
+    dull_free(&v);
+
+    pv = dull_find_object_value(&o, "World", 5);
+    EXPECT_TRUE(pv != NULL);
+    EXPECT_EQ_STRING("Hello", dull_get_string(pv), dull_get_string_length(pv));
+
+    i = dull_get_object_capacity(&o);
+    dull_clear_object(&o);
+    EXPECT_EQ_SIZE_T(0, dull_get_object_size(&o));
+    EXPECT_EQ_SIZE_T(i, dull_get_object_capacity(&o));
+    dull_shrink_object(&o);
+    EXPECT_EQ_SIZE_T(0, dull_get_object_capacity(&o));
+
+    dull_free(&o);
+}
+
+static void test_access_copied() {
+    dull_value v1, v2, v3, *pv;
+    DULL_INIT(&v1);
+    DULL_INIT(&v2);
+    DULL_INIT(&v3);
+    dull_parse(&v1, "{\"a\":[1,\"x\"],\"o\":{\"k\":\"v\"},\"u\":[\"kept\"]}");
+    dull_copy(&v2, &v1);
+    dull_free(&v1);
+
+    /* growing a node of a copied block gives it its own array, its children stay in the block */
+    pv = dull_get_object_value(&v2, 0);
+    dull_set_boolean(dull_pushback_array_element(pv), 1);
+    EXPECT_EQ_SIZE_T(3, dull_get_array_size(pv));
+    EXPECT_EQ_INT(DULL_F_DETACHED, pv->flags);
+    EXPECT_EQ_INT(DULL_F_POOLED, dull_get_array_element(pv, 1)->flags);
+    EXPECT_EQ_STRING("x", dull_get_string(dull_get_array_element(pv, 1)), dull_get_string_length(dull_get_array_element(pv, 1)));
+    dull_move(&v1, pv);
+
+    pv = dull_find_object_value(&v2, "o", 1);
+    dull_remove_object_value(pv, 0);
+    dull_set_number(dull_set_object_value(pv, "n", 1), 2.0);
+    EXPECT_EQ_DOUBLE(2.0, dull_get_number(dull_find_object_value(pv, "n", 1)));
+
+    /* so does the root, which still keeps the block alive */
+    dull_set_null(dull_set_object_value(&v2, "z", 1));
+    EXPECT_EQ_SIZE_T(4, dull_get_object_size(&v2));
+    EXPECT_EQ_INT(DULL_F_BLOCK | DULL_F_DETACHED, v2.flags);
+    pv = dull_find_object_value(&v2, "u", 1);
+    EXPECT_EQ_INT(DULL_F_POOLED, pv->flags);
+    dull_remove_object_value(&v2, 3);
+    dull_shrink_object(&v2);
+    EXPECT_EQ_SIZE_T(3, dull_get_object_capacity(&v2));
+    pv = dull_find_object_value(&v2, "u", 1);
+    EXPECT_EQ_STRING("kept", dull_get_string(dull_get_array_element(pv, 0)), dull_get_string_length(dull_get_array_element(pv, 0)));
+
+    /* a detached node still points into the block, so moving it out copies it */
+    dull_move(&v3, dull_find_object_value(&v2, "o", 1));
+    dull_free(&v2);
+    EXPECT_EQ_SIZE_T(3, dull_get_array_size(&v1));
+    EXPECT_EQ_DOUBLE(2.0, dull_get_number(dull_find_object_value(&v3, "n", 1)));
+    dull_free(&v1);
+    dull_free(&v3);
+}
+
 static void test_access() {
     test_access_null();
     test_access_boolean();
     test_access_number();
     test_access_string();
+    test_access_array();
+    test_access_object();
+    test_access_copied();
+}
+
+#define TEST_EQUAL(json1, json2, equality) \
+    do {\
+        dull_value v1, v2;\
+        DULL_INIT(&v1);\
+        DULL_INIT(&v2);\
+        EXPECT_EQ_INT(DULL_PARSE_OK, dull_parse(&v1, json1));\
+        EXPECT_EQ_INT(DULL_PARSE_OK, dull_parse(&v2, json2));\
+        EXPECT_EQ_INT(equality, dull_equal(&v1, &v2));\
+        EXPECT_EQ_INT(equality, dull_equal(&v2, &v1));\
+        if (equality)\
+            EXPECT_TRUE(dull_hash(&v1) == dull_hash(&v2));\
+        else\
+            EXPECT_TRUE(dull_hash(&v1) != dull_hash(&v2));\
+        dull_free(&v1);\
+        dull_free(&v2);\
+    } while(0)
+
+/* wide objects with every member out of place */
+static void test_equal_large() {
+    dull_value v1, v2;
+    char key[16];
+    int i, n = 20000;
+    DULL_INIT(&v1);
+    DULL_INIT(&v2);
+    dull_set_object(&v1, 0);
+    dull_set_object(&v2, 0);
+    for (i = 0; i < n; i++) {
+        dull_set_number(dull_set_object_value(&v1, key, sprintf(key, "k%d", i)), i);
+        dull_set_number(dull_set_object_value(&v2, key, sprintf(key, "k%d", n - 1 - i)), n - 1 - i);
+    }
+    EXPECT_EQ_INT(1, dull_equal(&v1, &v2));
+    EXPECT_TRUE(dull_hash(&v1) == dull_hash(&v2));
+    dull_set_number(dull_find_object_value(&v2, "k0", 2), -1);
+    EXPECT_EQ_INT(0, dull_equal(&v1, &v2));
+    EXPECT_EQ_INT(0, dull_equal(&v2, &v1));
+    dull_free(&v1);
+    dull_free(&v2);
+}
+
+static void test_equal() {
+    TEST_EQUAL("true", "true", 1);
+    TEST_EQUAL("true", "false", 0);
+    TEST_EQUAL("false", "false", 1);
+    TEST_EQUAL("null", "null", 1);
+    TEST_EQUAL("null", "0", 0);
+    TEST_EQUAL("123", "123", 1);
+    TEST_EQUAL("123", "456", 0);
+    TEST_EQUAL("0", "-0", 1);
+    TEST_EQUAL("\"abc\"", "\"abc\"", 1);
+    TEST_EQUAL("\"abc\"", "\"abcd\"", 0);
+    TEST_EQUAL("[]", "[]", 1);
+    TEST_EQUAL("[]", "null", 0);
+    TEST_EQUAL("[1,2,3]", "[1,2,3]", 1);
+    TEST_EQUAL("[1,2,3]", "[1,2,3,4]", 0);
+    TEST_EQUAL("[1,2,3]", "[3,2,1]", 0);
+    TEST_EQUAL("[[]]", "[[]]", 1);
+    TEST_EQUAL("[1,\"a\",[2]]", "[1,\"a\",[2]]", 1);
+    TEST_EQUAL("{}", "{}", 1);
+    TEST_EQUAL("{}", "null", 0);
+    TEST_EQUAL("{}", "[]", 0);
+    TEST_EQUAL("{\"a\":1,\"b\":2}", "{\"a\":1,\"b\":2}", 1);
+    TEST_EQUAL("{\"a\":1,\"b\":2}", "{\"b\":2,\"a\":1}", 1);
+    TEST_EQUAL("{\"a\":1,\"b\":2}", "{\"a\":1,\"b\":3}", 0);
+    TEST_EQUAL("{\"a\":1,\"b\":2}", "{\"a\":1,\"b\":2,\"c\":3}", 0);
+    TEST_EQUAL("{\"a\":1,\"b\":2}", "{\"a\":2,\"b\":1}", 0);
+    TEST_EQUAL("{\"a\":{\"b\":{\"c\":{}}}}", "{\"a\":{\"b\":{\"c\":{}}}}", 1);
+    TEST_EQUAL("{\"a\":{\"b\":{\"c\":{}}}}", "{\"a\":{\"b\":{\"c\":[]}}}", 0);
+    TEST_EQUAL("{\"x\":[1,{\"p\":1,\"q\":2}],\"y\":\"z\"}", "{\"y\":\"z\",\"x\":[1,{\"q\":2,\"p\":1}]}", 1);
+    /* repeated keys pair off one to one, in the order they appear */
+    TEST_EQUAL("{\"a\":1,\"a\":1}", "{\"a\":1,\"b\":1}", 0);
+    TEST_EQUAL("{\"a\":1,\"b\":1}", "{\"a\":1,\"a\":1}", 0);
+    TEST_EQUAL("{\"a\":1,\"a\":2,\"b\":3}", "{\"b\":3,\"a\":1,\"a\":2}", 1);
+    TEST_EQUAL("{\"b\":[],\"a\":1,\"ab\":2,\"a\":3}", "{\"a\":1,\"a\":3,\"ab\":2,\"b\":[]}", 1);
+    TEST_EQUAL("{\"a\":1,\"a\":1,\"a\":2}", "{\"a\":1,\"a\":2,\"a\":2}", 0);
+    {
+        /* the same members swapped compare unequal but may hash alike */
+        dull_value v1, v2;
+        DULL_INIT(&v1);
+        DULL_INIT(&v2);
+        EXPECT_EQ_INT(DULL_PARSE_OK, dull_parse(&v1, "{\"a\":1,\"a\":2}"));
+        EXPECT_EQ_INT(DULL_PARSE_OK, dull_parse(&v2, "{\"a\":2,\"a\":1}"));
+        EXPECT_EQ_INT(0, dull_equal(&v1, &v2));
+        EXPECT_EQ_INT(0, dull_equal(&v2, &v1));
+        dull_free(&v1);
+        dull_free(&v2);
+    }
+    test_equal_large();
+}
+
+static void test_copy() {
+    dull_value v1, v2;
+    dull_value* e;
+    DULL_INIT(&v1);
+    DULL_INIT(&v2);
+    dull_parse(&v1, "{\"t\":true,\"f\":false,\"n\":null,\"d\":1.5,\"a\":[1,2,\"x\",[]],\"o\":{\"s\":\"abc\"}}");
+    dull_copy(&v2, &v1);
+    dull_free(&v1);
+    EXPECT_EQ_INT(DULL_OBJECT, dull_get_type(&v2));
+    EXPECT_EQ_SIZE_T(6, dull_get_object_size(&v2));
+    EXPECT_EQ_STRING("d", dull_get_object_key(&v2, 3), dull_get_object_key_length(&v2, 3));
+    EXPECT_EQ_DOUBLE(1.5, dull_get_number(dull_get_object_value(&v2, 3)));
+    e = dull_get_object_value(&v2, 4);
+    EXPECT_EQ_SIZE_T(4, dull_get_array_size(e));
+    EXPECT_EQ_STRING("x", dull_get_string(dull_get_array_element(e, 2)), dull_get_string_length(dull_get_array_element(e, 2)));
+    EXPECT_EQ_SIZE_T(0, dull_get_array_size(dull_get_array_element(e, 3)));
+    e = dull_get_object_value(dull_get_object_value(&v2, 5), 0);
+    EXPECT_EQ_STRING("abc", dull_get_string(e), dull_get_string_length(e));
+
+    /* values inside the copied block can still be replaced individually */
+    dull_set_string(e, "Hello", 5);
+    EXPECT_EQ_STRING("Hello", dull_get_string(e), dull_get_string_length(e));
+    dull_copy(&v1, dull_get_object_value(&v2, 4));
+    EXPECT_EQ_SIZE_T(4, dull_get_array_size(&v1));
+    dull_copy(&v2, dull_get_object_value(&v2, 5));
+    EXPECT_EQ_SIZE_T(1, dull_get_object_size(&v2));
+    dull_free(&v1);
+    dull_free(&v2);
+}
+
+static void test_move() {
+    dull_value v1, v2, v3;
+    dull_value* e;
+    DULL_INIT(&v1);
+    DULL_INIT(&v2);
+    DULL_INIT(&v3);
+    dull_parse(&v1, "[\"abc\",[1,2]]");
+    dull_move(&v2, &v1);
+    EXPECT_EQ_INT(DULL_NULL, dull_get_type(&v1));
+    EXPECT_EQ_SIZE_T(2, dull_get_array_size(&v2));
+
+    /* moving out of a copied block falls back to a copy */
+    dull_copy(&v1, &v2);
+    dull_move(&v3, dull_get_array_element(&v1, 1));
+    EXPECT_EQ_INT(DULL_NULL, dull_get_type(dull_get_array_element(&v1, 1)));
+    dull_free(&v1);
+    EXPECT_EQ_SIZE_T(2, dull_get_array_size(&v3));
+    e = dull_get_array_element(&v3, 1);
+    EXPECT_EQ_DOUBLE(2.0, dull_get_number(e));
+
+    /* a child may replace its own parent, owned or pooled */
+    dull_move(&v2, dull_get_array_element(&v2, 1));
+    EXPECT_EQ_SIZE_T(2, dull_get_array_size(&v2));
+    EXPECT_EQ_DOUBLE(1.0, dull_get_number(dull_get_array_element(&v2, 0)));
+    dull_copy(&v1, &v3);
+    dull_move(&v1, dull_get_array_element(&v1, 1));
+    EXPECT_EQ_DOUBLE(2.0, dull_get_number(&v1));
+    dull_free(&v1);
+    dull_free(&v2);
+    dull_free(&v3);
+}
+
+static void test_swap() {
+    dull_value v1, v2;
+    DULL_INIT(&v1);
+    DULL_INIT(&v2);
+    dull_set_string(&v1, "Hello",  5);
+    dull_set_string(&v2, "World!", 6);
+    dull_swap(&v1, &v2);
+    EXPECT_EQ_STRING("World!", dull_get_string(&v1), dull_get_string_length(&v1));
+    EXPECT_EQ_STRING("Hello",  dull_get_string(&v2), dull_get_string_length(&v2));
+
+    /* swapping with a value inside a copied block */
+    dull_value v3;
+    DULL_INIT(&v3);
+    dull_parse(&v3, "[\"abc\",true]");
+    dull_copy(&v2, &v3);
+    dull_free(&v3);
+    dull_swap(&v1, dull_get_array_element(&v2, 0));
+    EXPECT_EQ_STRING("abc", dull_get_string(&v1), dull_get_string_length(&v1));
+    EXPECT_EQ_STRING("World!", dull_get_string(dull_get_array_element(&v2, 0)), dull_get_string_length(dull_get_array_element(&v2, 0)));
+    dull_free(&v1);
+    dull_free(&v2);
+}
+
+static void test_snapshot() {
+    const char* path = "dull_test_snapshot.bin";
+    char text[256];
+    dull_value v1, v2, *pv;
+    DULL_INIT(&v1);
+    DULL_INIT(&v2);
+
+    EXPECT_EQ_INT(DULL_PARSE_OK, dull_parse(&v1, "{\"a\":[1,\"xy\",[],{}],\"o\":{\"k\":\"v\",\"t\":true},\"s\":\"\"}"));
+    EXPECT_EQ_INT(0, dull_save_snapshot(&v1, path));
+    dull_free(&v1);
+    EXPECT_EQ_INT(DULL_PARSE_OK, dull_load_snapshot(&v2, path));
+    EXPECT_EQ_SIZE_T(3, dull_get_object_size(&v2));
+    pv = dull_find_object_value(&v2, "a", 1);
+    EXPECT_EQ_SIZE_T(4, dull_get_array_size(pv));
+    EXPECT_EQ_DOUBLE(1.0, dull_get_number(dull_get_array_element(pv, 0)));
+    EXPECT_EQ_STRING("xy", dull_get_string(dull_get_array_element(pv, 1)), dull_get_string_length(dull_get_array_element(pv, 1)));
+    EXPECT_EQ_SIZE_T(0, dull_get_object_size(dull_get_array_element(pv, 3)));
+    pv = dull_find_object_value(&v2, "o", 1);
+    EXPECT_EQ_INT(DULL_TRUE, dull_get_type(dull_find_object_value(pv, "t", 1)));
+    pv = dull_find_object_value(&v2, "s", 1);
+    EXPECT_EQ_STRING("", dull_get_string(pv), dull_get_string_length(pv));
+
+    /* a loaded snapshot is an ordinary tree, growing one node leaves the rest in the block */
+    dull_set_number(dull_pushback_array_element(dull_find_object_value(&v2, "a", 1)), 2.0);
+    EXPECT_EQ_SIZE_T(5, dull_get_array_size(dull_find_object_value(&v2, "a", 1)));
+    EXPECT_EQ_INT(DULL_F_POOLED, dull_find_object_value(&v2, "o", 1)->flags);
+    dull_set_boolean(dull_set_object_value(&v2, "b", 1), 0);
+    EXPECT_EQ_INT(DULL_F_BLOCK | DULL_F_DETACHED, v2.flags);
+    EXPECT_EQ_INT(DULL_F_POOLED, dull_find_object_value(&v2, "o", 1)->flags);
+    dull_free(&v2);
+
+    dull_set_number(&v1, 1.5);
+    EXPECT_EQ_INT(0, dull_save_snapshot(&v1, path));
+    EXPECT_EQ_INT(DULL_PARSE_OK, dull_load_snapshot(&v2, path));
+    EXPECT_EQ_DOUBLE(1.5, dull_get_number(&v2));
+    dull_free(&v2);
+
+    test_write_file(path, "DULLSNAP", 8);
+    EXPECT_EQ_INT(DULL_PARSE_FILE_ERROR, dull_load_snapshot(&v2, path));
+    memset(text, ' ', sizeof(text));
+    text[0] = '[';
+    text[sizeof(text) - 1] = ']';
+    test_write_file(path, text, sizeof(text));
+    EXPECT_EQ_INT(DULL_PARSE_INVALID_SNAPSHOT, dull_load_snapshot(&v2, path));
+    EXPECT_EQ_INT(DULL_NULL, dull_get_type(&v2));
+    remove(path);
+}
+
+/* rewrites one size_t of a saved snapshot and expects the load to fail */
+#define TEST_SNAPSHOT_CORRUPT(error, pos, value)\
+    do {\
+        size_t word = (value);\
+        memcpy(corrupt, image, len);\
+        memcpy(corrupt + (pos), &word, sizeof(word));\
+        test_write_file(path, corrupt, len);\
+        EXPECT_EQ_INT(error, dull_load_snapshot(&v, path));\
+        EXPECT_EQ_INT(DULL_NULL, dull_get_type(&v));\
+    } while(0)
+
+static void test_snapshot_corrupt() {
+    const char* path = "dull_test_snapshot_corrupt.bin";
+    /* the header: magic, version, value size, block size, then the root */
+    const size_t root = 8 + 2 * sizeof(unsigned) + sizeof(size_t);
+    const size_t block = root + sizeof(dull_value);
+    const size_t root_storage = root + offsetof(dull_value, u);
+    char image[1024], corrupt[1024];
+    size_t len, block_size;
+    dull_value v;
+    FILE* fp;
+
+    DULL_INIT(&v);
+    EXPECT_EQ_INT(DULL_PARSE_OK, dull_parse(&v, "{\"a\":[1,\"xy\"],\"s\":\"zz\"}"));
+    EXPECT_EQ_INT(0, dull_save_snapshot(&v, path));
+    dull_free(&v);
+    fp = fopen(path, "rb");
+    len = fread(image, 1, sizeof(image), fp);
+    fclose(fp);
+    block_size = len - block;
+    EXPECT_EQ_INT(DULL_PARSE_OK, dull_load_snapshot(&v, path));
+    dull_free(&v);
+
+    /* bad magic */
+    memcpy(corrupt, image, len);
+    corrupt[0] ^= 1;
+    test_write_file(path, corrupt, len);
+    EXPECT_EQ_INT(DULL_PARSE_INVALID_SNAPSHOT, dull_load_snapshot(&v, path));
+
+    /* truncated, in the block and in the header */
+    test_write_file(path, image, len - 1);
+    EXPECT_EQ_INT(DULL_PARSE_INVALID_SNAPSHOT, dull_load_snapshot(&v, path));
+    test_write_file(path, image, block - 1);
+    EXPECT_EQ_INT(DULL_PARSE_FILE_ERROR, dull_load_snapshot(&v, path));
+    TEST_SNAPSHOT_CORRUPT(DULL_PARSE_INVALID_SNAPSHOT, root - sizeof(size_t), (size_t)-1);
+
+    /* offsets past the end, misaligned, or pointing back into storage already claimed */
+    TEST_SNAPSHOT_CORRUPT(DULL_PARSE_INVALID_SNAPSHOT, root_storage, block_size + sizeof(double));
+    TEST_SNAPSHOT_CORRUPT(DULL_PARSE_INVALID_SNAPSHOT, root_storage, 1);
+    TEST_SNAPSHOT_CORRUPT(DULL_PARSE_INVALID_SNAPSHOT, block + offsetof(dull_member, k), 0);
+    TEST_SNAPSHOT_CORRUPT(DULL_PARSE_INVALID_SNAPSHOT, block + offsetof(dull_member, k), block_size);
+    TEST_SNAPSHOT_CORRUPT(DULL_PARSE_INVALID_SNAPSHOT, block + offsetof(dull_member, klen), block_size);
+    remove(path);
+}
+
+#define TEST_DOCUMENT_KEYS 64
+#define TEST_DOCUMENT_THREADS 8
+
+static dull_document* test_make_document() {
+    dull_value v;
+    char key[16];
+    int i;
+    DULL_INIT(&v);
+    dull_set_object(&v, 0);
+    for (i = 0; i < TEST_DOCUMENT_KEYS; i++)
+        dull_set_number(dull_set_object_value(&v, key, sprintf(key, "key%d", i)), i);
+    dull_set_object(dull_set_object_value(&v, "small", 5), 0);
+    return dull_freeze(&v);
+}
+
+/* returns the number of keys that were not found with the right value */
+static int test_document_lookups(dull_document* d) {
+    const dull_value* root = dull_document_root(d);
+    char key[16];
+    int i, misses = 0;
+    for (i = 0; i < TEST_DOCUMENT_KEYS; i++) {
+        const dull_value* e = dull_document_find(d, root, key, sprintf(key, "key%d", i));
+        if (e == NULL || dull_get_number(e) != i)
+            misses++;
+    }
+    if (dull_document_find(d, root, "key", 3) != NULL)
+        misses++;
+    return misses;
+}
+
+#ifdef TEST_THREADS
+static void* test_document_thread(void* arg) {
+    dull_document* d = (dull_document*)arg;
+    size_t misses = test_document_lookups(d);
+    dull_document_release(d);
+    return (void*)misses;
+}
+#endif
+
+static void test_document() {
+    dull_value v;
+    dull_document* d;
+    const dull_value* small;
+
+    DULL_INIT(&v);
+    dull_parse(&v, "{\"a\":1,\"b\":[true]}");
+    d = dull_freeze(&v);
+    EXPECT_EQ_INT(DULL_NULL, dull_get_type(&v));
+    EXPECT_EQ_DOUBLE(1.0, dull_get_number(dull_find_object_value_const(dull_document_root(d), "a", 1)));
+    EXPECT_EQ_INT(DULL_TRUE, dull_get_type(dull_get_array_element_const(dull_find_object_value_const(dull_document_root(d), "b", 1), 0)));
+    EXPECT_TRUE(dull_get_array_element_const(dull_find_object_value_const(dull_document_root(d), "b", 1), 1) == NULL);
+    EXPECT_TRUE(dull_document_retain(d) == d);
+    dull_document_release(d);
+    EXPECT_EQ_DOUBLE(1.0, dull_get_number(dull_document_find(d, dull_document_root(d), "a", 1)));
+    dull_document_release(d);
+
+    d = test_make_document();
+    EXPECT_EQ_INT(0, test_document_lookups(d));
+    small = dull_document_find(d, dull_document_root(d), "small", 5);
+    EXPECT_TRUE(small != NULL && dull_find_object_value_const(small, "x", 1) == NULL);
+    dull_document_release(d);
+
+#ifdef TEST_THREADS
+    {
+        /* every thread races to build the index of a fresh document */
+        pthread_t threads[TEST_DOCUMENT_THREADS];
+        void* misses;
+        int i;
+        d = test_make_document();
+        for (i = 0; i < TEST_DOCUMENT_THREADS; i++)
+            pthread_create(&threads[i], NULL, test_document_thread, dull_document_retain(d));
+        dull_document_release(d);
+        for (i = 0; i < TEST_DOCUMENT_THREADS; i++) {
+            pthread_join(threads[i], &misses);
+            EXPECT_EQ_SIZE_T(0, (size_t)misses);
+        }
+    }
+#endif
+}
+
+typedef struct {
+    char out[256];
+    size_t len;
+    int flushes;
+} test_sink;
+
+static int test_sink_write(void* user, const char* data, size_t len) {
+    test_sink* sink = (test_sink*)user;
+    if (sink->len + len >= sizeof(sink->out))
+        return -1;
+    memcpy(sink->out + sink->len, data, len);
+    sink->len += len;
+    sink->out[sink->len] = '\0';
+    sink->flushes++;
+    return 0;
+}
+
+#define TEST_WRITER_OUTPUT(expect, sink)\
+    EXPECT_EQ_STRING(expect, (sink).out, (sink).len)
+
+static void test_writer() {
+    dull_writer w;
+    test_sink sink;
+    char buf[8];
+
+    memset(&sink, 0, sizeof(sink));
+    dull_writer_init(&w, buf, sizeof(buf), test_sink_write, &sink);
+    EXPECT_EQ_INT(DULL_WRITE_OK, dull_writer_begin_object(&w));
+    EXPECT_EQ_INT(DULL_WRITE_OK, dull_writer_key(&w, "n", 1));
+    EXPECT_EQ_INT(DULL_WRITE_OK, dull_writer_null(&w));
+    EXPECT_EQ_INT(DULL_WRITE_OK, dull_writer_key(&w, "a", 1));
+    EXPECT_EQ_INT(DULL_WRITE_OK, dull_writer_begin_array(&w));
+    EXPECT_EQ_INT(DULL_WRITE_OK, dull_writer_boolean(&w, 1));
+    EXPECT_EQ_INT(DULL_WRITE_OK, dull_writer_number(&w, 1.5));
+    EXPECT_EQ_INT(DULL_WRITE_OK, dull_writer_string(&w, "\" \\ / \b \f \n \r \t\x01", 16));
+    EXPECT_EQ_INT(DULL_WRITE_OK, dull_writer_begin_object(&w));
+    EXPECT_EQ_INT(DULL_WRITE_OK, dull_writer_end_object(&w));
+    EXPECT_EQ_INT(DULL_WRITE_OK, dull_writer_end_array(&w));
+    EXPECT_EQ_INT(DULL_WRITE_OK, dull_writer_end_object(&w));
+    EXPECT_EQ_INT(DULL_WRITE_OK, dull_writer_flush(&w));
+    TEST_WRITER_OUTPUT("{\"n\":null,\"a\":[true,1.5,\"\\\" \\\\ / \\b \\f \\n \\r \\t\\u0001\",{}]}", sink);
+    EXPECT_TRUE(sink.flushes > 1);
+
+    /* the writer tracks where keys and values are allowed */
+    memset(&sink, 0, sizeof(sink));
+    dull_writer_init(&w, buf, sizeof(buf), test_sink_write, &sink);
+    EXPECT_EQ_INT(DULL_WRITE_INVALID_STATE, dull_writer_key(&w, "a", 1));
+    EXPECT_EQ_INT(DULL_WRITE_OK, dull_writer_begin_array(&w));
+    EXPECT_EQ_INT(DULL_WRITE_INVALID_STATE, dull_writer_key(&w, "a", 1));
+    EXPECT_EQ_INT(DULL_WRITE_INVALID_STATE, dull_writer_end_object(&w));
+    EXPECT_EQ_INT(DULL_WRITE_OK, dull_writer_begin_object(&w));
+    EXPECT_EQ_INT(DULL_WRITE_INVALID_STATE, dull_writer_null(&w));
+    EXPECT_EQ_INT(DULL_WRITE_OK, dull_writer_key(&w, "a", 1));
+    EXPECT_EQ_INT(DULL_WRITE_INVALID_STATE, dull_writer_key(&w, "b", 1));
+    EXPECT_EQ_INT(DULL_WRITE_INVALID_STATE, dull_writer_end_object(&w));
+    EXPECT_EQ_INT(DULL_WRITE_INVALID_NUMBER, dull_writer_number(&w, HUGE_VAL));
+    EXPECT_EQ_INT(DULL_WRITE_OK, dull_writer_number(&w, 0));
+    EXPECT_EQ_INT(DULL_WRITE_OK, dull_writer_end_object(&w));
+    EXPECT_EQ_INT(DULL_WRITE_OK, dull_writer_end_array(&w));
+    EXPECT_EQ_INT(DULL_WRITE_INVALID_STATE, dull_writer_null(&w));
+    EXPECT_EQ_INT(DULL_WRITE_OK, dull_writer_flush(&w));
+    TEST_WRITER_OUTPUT("[{\"a\":0}]", sink);
+}
+
+static void test_writer_value() {
+    dull_value v;
+    dull_writer w;
+    test_sink sink;
+    char buf[16];
+    const char json[] = "{\"s\":\"Hello\\u0000World\",\"a\":[null,false,[],{}],\"d\":-1.25e-10}";
+
+    DULL_INIT(&v);
+    EXPECT_EQ_INT(DULL_PARSE_OK, dull_parse(&v, json));
+    memset(&sink, 0, sizeof(sink));
+    dull_writer_init(&w, buf, sizeof(buf), test_sink_write, &sink);
+    EXPECT_EQ_INT(DULL_WRITE_OK, dull_writer_value(&w, &v));
+    EXPECT_EQ_INT(DULL_WRITE_OK, dull_writer_flush(&w));
+    TEST_WRITER_OUTPUT("{\"s\":\"Hello\\u0000World\",\"a\":[null,false,[],{}],\"d\":-1.2500000000000001e-10}", sink);
+    dull_free(&v);
+
+    /* a failing sink makes the error sticky */
+    memset(&sink, 0, sizeof(sink));
+    sink.len = sizeof(sink.out) - 1;
+    dull_writer_init(&w, buf, sizeof(buf), test_sink_write, &sink);
+    dull_set_string(&v, "0123456789abcdef0123456789", 26);
+    EXPECT_EQ_INT(DULL_WRITE_FLUSH_ERROR, dull_writer_value(&w, &v));
+    EXPECT_EQ_INT(DULL_WRITE_FLUSH_ERROR, dull_writer_flush(&w));
+    dull_free(&v);
+}
+
+/* every budget must build the tree, or fail at the offset, that dull_parse_ex() does */
+static int test_async_parse_budget(const char* json, size_t budget) {
+    dull_value v, expect;
+    dull_parse_result r, er;
+    dull_async_parser* p;
+    int ret, steps = 0;
+
+    DULL_INIT(&expect);
+    dull_parse_ex(&expect, json, &er);
+    p = dull_async_parse_begin(&v, json);
+    while ((ret = dull_async_parse_step(p, budget)) == DULL_PARSE_PENDING)
+        steps++;
+    EXPECT_EQ_INT(ret, dull_async_parse_end(p, &r));
+    EXPECT_EQ_INT(er.code, r.code);
+    EXPECT_EQ_SIZE_T(er.offset, r.offset);
+    EXPECT_TRUE(dull_equal(&expect, &v));
+    dull_free(&v);
+    dull_free(&expect);
+    return steps;
+}
+
+static void test_async_parse() {
+    static const char* const jsons[] = {
+        "null", " 12.5 ", "\"\\u20AC\"", "[]", " { } ",
+        "{\"a\":[1,[2,[3,{}]],{\"b\":\"c\"}],\"d\":[true,false,null],\"e\":{\"f\":{}}}",
+        "[1,]", "[1 2]", "{\"a\" 1}", "{\"a\":1,}", "{1:2}", "{\"a\":1 \"b\":2}",
+        "{\"\":{\"\":1}}", "[[[\"abc\\q\"]]]", "[1e309]", "{\"a\":[1,2]} x", "[nul]", "", "[\"a\", {\"b\": [1, 2, \"c\""
+    };
+    static const size_t budgets[] = { 0, 1, 3, 16, 4096 };
+    size_t i, j;
+    char deep[20001];
+    dull_value v;
+    dull_async_parser* p;
+
+    for (i = 0; i < sizeof(jsons) / sizeof(jsons[0]); i++)
+        for (j = 0; j < sizeof(budgets) / sizeof(budgets[0]); j++)
+            test_async_parse_budget(jsons[i], budgets[j]);
+    /* a small budget hands control back between tokens */
+    EXPECT_TRUE(test_async_parse_budget(jsons[5], 1) > 20);
+
+    /* nesting costs frames on the heap, not C stack */
+    for (i = 0; i < 10000; i++) {
+        deep[i] = '[';
+        deep[20000 - 1 - i] = ']';
+    }
+    deep[20000] = '\0';
+    p = dull_async_parse_begin(&v, deep);
+    while (dull_async_parse_step(p, 1024) == DULL_PARSE_PENDING);
+    EXPECT_EQ_INT(DULL_PARSE_OK, dull_async_parse_end(p, NULL));
+    EXPECT_EQ_INT(DULL_ARRAY, dull_get_type(&v));
+    dull_free(&v);
+
+    /* a parse given up half way leaves nothing behind */
+    p = dull_async_parse_begin(&v, "{\"a\":[1,{\"b\":[\"x\",\"y\"]},3],\"c\":4}");
+    EXPECT_EQ_INT(DULL_PARSE_PENDING, dull_async_parse_step(p, 16));
+    EXPECT_EQ_INT(DULL_PARSE_PENDING, dull_async_parse_end(p, NULL));
+    EXPECT_EQ_INT(DULL_NULL, dull_get_type(&v));
+}
+
+#define TEST_PATCH(error, expect, json, patch)\
+    do {\
+        dull_value patched, ops, expected;\
+        DULL_INIT(&patched);\
+        DULL_INIT(&ops);\
+        DULL_INIT(&expected);\
+        EXPECT_EQ_INT(DULL_PARSE_OK, dull_parse(&patched, json));\
+        EXPECT_EQ_INT(DULL_PARSE_OK, dull_parse(&ops, patch));\
+        EXPECT_EQ_INT(DULL_PARSE_OK, dull_parse(&expected, expect));\
+        EXPECT_EQ_INT(error, dull_apply_patch(&patched, &ops));\
+        EXPECT_TRUE(dull_equal(&patched, &expected));\
+        dull_free(&patched);\
+        dull_free(&ops);\
+        dull_free(&expected);\
+    } while(0)
+
+static void test_patch() {
+    const char doc[] = "{\"a\":[1,2,{\"b\":true}],\"c~/d\":null}";
+    dull_value v, copied, p, e;
+
+    TEST_PATCH(DULL_PATCH_OK, "{\"baz\":\"qux\",\"foo\":\"bar\"}",
+        "{\"foo\":\"bar\"}", "[{\"op\":\"add\",\"path\":\"/baz\",\"value\":\"qux\"}]");
+    TEST_PATCH(DULL_PATCH_OK, "{\"foo\":[\"bar\",\"qux\",\"baz\"]}",
+        "{\"foo\":[\"bar\",\"baz\"]}", "[{\"op\":\"add\",\"path\":\"/foo/1\",\"value\":\"qux\"}]");
+    TEST_PATCH(DULL_PATCH_OK, "{\"a\":[1,2,{\"b\":true},[]],\"c~/d\":null}",
+        doc, "[{\"op\":\"add\",\"path\":\"/a/-\",\"value\":[]}]");
+    TEST_PATCH(DULL_PATCH_OK, "{\"a\":[1,{\"b\":true}]}",
+        doc, "[{\"op\":\"remove\",\"path\":\"/a/1\"},{\"op\":\"remove\",\"path\":\"/c~0~1d\"}]");
+    TEST_PATCH(DULL_PATCH_OK, "{\"a\":[1,2,{\"b\":false}],\"c~/d\":0}",
+        doc, "[{\"op\":\"replace\",\"path\":\"/a/2/b\",\"value\":false},{\"op\":\"replace\",\"path\":\"/c~0~1d\",\"value\":0}]");
+    TEST_PATCH(DULL_PATCH_OK, "{\"a\":[2,{\"b\":true,\"x\":1}],\"c~/d\":null}",
+        doc, "[{\"op\":\"move\",\"from\":\"/a/0\",\"path\":\"/a/1/x\"}]");
+    TEST_PATCH(DULL_PATCH_OK, "{\"a\":[{\"b\":true},1,2,{\"b\":true}],\"c~/d\":null}",
+        doc, "[{\"op\":\"copy\",\"from\":\"/a/2\",\"path\":\"/a/0\"},{\"op\":\"test\",\"path\":\"/a/0\",\"value\":{\"b\":true}}]");
+    TEST_PATCH(DULL_PATCH_OK, "[1,2,{\"b\":true}]", doc, "[{\"op\":\"move\",\"from\":\"/a\",\"path\":\"\"}]");
+    TEST_PATCH(DULL_PATCH_OK, "42", doc, "[{\"op\":\"replace\",\"path\":\"\",\"value\":42}]");
+
+    /* a failing operation undoes everything before it */
+    TEST_PATCH(DULL_PATCH_TEST_FAILED, doc, doc,
+        "[{\"op\":\"remove\",\"path\":\"/a/0\"},{\"op\":\"add\",\"path\":\"/n\",\"value\":1},"
+        "{\"op\":\"move\",\"from\":\"/a/1\",\"path\":\"/c~0~1d\"},{\"op\":\"replace\",\"path\":\"\",\"value\":[]},"
+        "{\"op\":\"test\",\"path\":\"\",\"value\":{}}]");
+    TEST_PATCH(DULL_PATCH_PATH_NOT_FOUND, doc, doc,
+        "[{\"op\":\"add\",\"path\":\"/a/0\",\"value\":0},{\"op\":\"remove\",\"path\":\"/a/4\"}]");
+    TEST_PATCH(DULL_PATCH_PATH_NOT_FOUND, doc, doc, "[{\"op\":\"add\",\"path\":\"/a/01\",\"value\":0}]");
+    TEST_PATCH(DULL_PATCH_PATH_NOT_FOUND, doc, doc, "[{\"op\":\"replace\",\"path\":\"/x\",\"value\":0}]");
+    TEST_PATCH(DULL_PATCH_PATH_NOT_FOUND, doc, doc, "[{\"op\":\"add\",\"path\":\"/x/y\",\"value\":0}]");
+    TEST_PATCH(DULL_PATCH_INVALID_OPERATION, doc, doc, "[{\"op\":\"move\",\"from\":\"/a\",\"path\":\"/a/0\"}]");
+    TEST_PATCH(DULL_PATCH_INVALID_OPERATION, doc, doc, "[{\"op\":\"add\",\"path\":\"/x\"}]");
+    TEST_PATCH(DULL_PATCH_INVALID_OPERATION, doc, doc, "[{\"op\":\"add\",\"path\":\"x\",\"value\":0}]");
+    TEST_PATCH(DULL_PATCH_INVALID_OPERATION, doc, doc, "[{\"op\":\"add\",\"path\":\"/~2\",\"value\":0}]");
+    TEST_PATCH(DULL_PATCH_INVALID_OPERATION, doc, doc, "[{\"op\":\"frob\",\"path\":\"\"}]");
+    TEST_PATCH(DULL_PATCH_INVALID_OPERATION, doc, doc, "{}");
+
+    /* the rollback also restores a tree that shares one block */
+    DULL_INIT(&v);
+    DULL_INIT(&copied);
+    DULL_INIT(&p);
+    EXPECT_EQ_INT(DULL_PARSE_OK, dull_parse(&v, doc));
+    dull_copy(&copied, &v);
+    EXPECT_EQ_INT(DULL_PARSE_OK, dull_parse(&p, "[{\"op\":\"move\",\"from\":\"/a/2\",\"path\":\"/z\"},"
+        "{\"op\":\"remove\",\"path\":\"/c~0~1d\"},{\"op\":\"add\",\"path\":\"/a/0\",\"value\":0},{\"op\":\"remove\",\"path\":\"/q\"}]"));
+    EXPECT_EQ_INT(DULL_PATCH_PATH_NOT_FOUND, dull_apply_patch(&copied, &p));
+    EXPECT_TRUE(dull_equal(&v, &copied));
+    EXPECT_EQ_STRING("c~/d", dull_get_object_key(&copied, 1), dull_get_object_key_length(&copied, 1));
+    dull_free(&v);
+    dull_free(&copied);
+    dull_free(&p);
+
+    /* patching a copied tree only gives the containers on the touched paths storage of their own */
+    DULL_INIT(&v);
+    DULL_INIT(&copied);
+    DULL_INIT(&p);
+    EXPECT_EQ_INT(DULL_PARSE_OK, dull_parse(&v, "[{\"id\":0,\"tags\":[\"a\"]},{\"id\":1,\"tags\":[]},{\"id\":2}]"));
+    dull_copy(&copied, &v);
+    EXPECT_EQ_INT(DULL_PARSE_OK, dull_parse(&p, "[{\"op\":\"add\",\"path\":\"/-\",\"value\":{\"id\":3}},"
+        "{\"op\":\"add\",\"path\":\"/0/tags/-\",\"value\":\"b\"}]"));
+    EXPECT_EQ_INT(DULL_PATCH_OK, dull_apply_patch(&copied, &p));
+    EXPECT_EQ_SIZE_T(4, dull_get_array_size(&copied));
+    EXPECT_EQ_INT(DULL_F_BLOCK | DULL_F_DETACHED, copied.flags);
+    EXPECT_EQ_INT(DULL_F_DETACHED, dull_find_object_value(dull_get_array_element(&copied, 0), "tags", 4)->flags);
+    EXPECT_EQ_INT(DULL_F_POOLED, dull_get_array_element(&copied, 0)->flags);
+    EXPECT_EQ_INT(DULL_F_POOLED, dull_get_array_element(&copied, 1)->flags);
+    EXPECT_EQ_INT(DULL_F_POOLED, dull_get_array_element(&copied, 2)->flags);
+    EXPECT_EQ_SIZE_T(2, dull_get_array_size(dull_find_object_value(dull_get_array_element(&copied, 0), "tags", 4)));
+    dull_free(&p);
+    /* and moving a value out of a detached node still leaves both sides intact */
+    EXPECT_EQ_INT(DULL_PARSE_OK, dull_parse(&p, "[{\"op\":\"move\",\"from\":\"/0/tags\",\"path\":\"/1/tags\"}]"));
+    EXPECT_EQ_INT(DULL_PATCH_OK, dull_apply_patch(&copied, &p));
+    EXPECT_EQ_SIZE_T(2, dull_get_array_size(dull_find_object_value(dull_get_array_element(&copied, 1), "tags", 4)));
+    EXPECT_EQ_SIZE_T(DULL_KEY_NOT_EXIST, dull_find_object_index(dull_get_array_element(&copied, 0), "tags", 4));
+    dull_free(&v);
+    dull_free(&copied);
+    dull_free(&p);
+
+    /* a removed member goes back to its own slot even when its key repeats */
+    DULL_INIT(&v);
+    DULL_INIT(&p);
+    EXPECT_EQ_INT(DULL_PARSE_OK, dull_parse(&v, "{\"a\":1,\"a\":2,\"b\":3}"));
+    EXPECT_EQ_INT(DULL_PARSE_OK, dull_parse(&p, "[{\"op\":\"remove\",\"path\":\"/a\"},{\"op\":\"test\",\"path\":\"/b\",\"value\":0}]"));
+    EXPECT_EQ_INT(DULL_PATCH_TEST_FAILED, dull_apply_patch(&v, &p));
+    EXPECT_EQ_SIZE_T(3, dull_get_object_size(&v));
+    EXPECT_EQ_STRING("a", dull_get_object_key(&v, 0), dull_get_object_key_length(&v, 0));
+    EXPECT_EQ_DOUBLE(1.0, dull_get_number(dull_get_object_value(&v, 0)));
+    EXPECT_EQ_STRING("a", dull_get_object_key(&v, 1), dull_get_object_key_length(&v, 1));
+    EXPECT_EQ_DOUBLE(2.0, dull_get_number(dull_get_object_value(&v, 1)));
+    EXPECT_EQ_STRING("b", dull_get_object_key(&v, 2), dull_get_object_key_length(&v, 2));
+    EXPECT_EQ_DOUBLE(3.0, dull_get_number(dull_get_object_value(&v, 2)));
+    dull_free(&v);
+    dull_free(&p);
+
+    /* the example from RFC 7386 */
+    DULL_INIT(&v);
+    DULL_INIT(&p);
+    DULL_INIT(&e);
+    EXPECT_EQ_INT(DULL_PARSE_OK, dull_parse(&v,
+        "{\"title\":\"Goodbye!\",\"author\":{\"givenName\":\"John\",\"familyName\":\"Doe\"},\"tags\":[\"example\",\"sample\"],\"content\":\"This will be unchanged\"}"));
+    EXPECT_EQ_INT(DULL_PARSE_OK, dull_parse(&p,
+        "{\"title\":\"Hello!\",\"phoneNumber\":\"+01-123-456-7890\",\"author\":{\"familyName\":null},\"tags\":[\"example\"]}"));
+    EXPECT_EQ_INT(DULL_PARSE_OK, dull_parse(&e,
+        "{\"title\":\"Hello!\",\"author\":{\"givenName\":\"John\"},\"tags\":[\"example\"],\"content\":\"This will be unchanged\",\"phoneNumber\":\"+01-123-456-7890\"}"));
+    dull_copy(&copied, &v);
+    dull_apply_merge_patch(&v, &p);
+    EXPECT_TRUE(dull_equal(&v, &e));
+    dull_apply_merge_patch(&copied, &p);
+    EXPECT_TRUE(dull_equal(&copied, &e));
+    dull_free(&p);
+    EXPECT_EQ_INT(DULL_PARSE_OK, dull_parse(&p, "{\"a\":{\"b\":{\"c\":null}},\"author\":null}"));
+    dull_apply_merge_patch(&v, &p);
+    EXPECT_EQ_SIZE_T(DULL_KEY_NOT_EXIST, dull_find_object_index(&v, "author", 6));
+    EXPECT_EQ_INT(DULL_OBJECT, dull_get_type(dull_find_object_value(dull_find_object_value(&v, "a", 1), "b", 1)));
+    dull_free(&p);
+    EXPECT_EQ_INT(DULL_PARSE_OK, dull_parse(&p, "[1]"));
+    dull_apply_merge_patch(&v, &p);
+    EXPECT_TRUE(dull_equal(&v, &p));
+    dull_free(&v);
+    dull_free(&copied);
+    dull_free(&p);
+    dull_free(&e);
+}
+
+#define TEST_MINIFY(expect, json, flags)\
+    do {\
+        char out[256];\
+        size_t out_len;\
+        EXPECT_EQ_INT(DULL_PARSE_OK, dull_minify(json, sizeof(json) - 1, out, &out_len, flags));\
+        out[out_len] = '\0';\
+        EXPECT_EQ_STRING(expect, out, out_len);\
+    } while(0)
+
+#define TEST_MINIFY_ERROR(error, json)\
+    do {\
+        char out[256];\
+        size_t out_len = 1;\
+        EXPECT_EQ_INT(error, dull_minify(json, sizeof(json) - 1, out, &out_len, 0));\
+        EXPECT_EQ_SIZE_T(0, out_len);\
+    } while(0)
+
+static void test_minify() {
+    char json[] = " { \"a\" : [ 1 , -2.5e+3 , true , false , null ] ,\n\t\"b\\u00e9\\/\" : { } , \"c\" : [ ] } \r\n";
+    size_t len = sizeof(json) - 1;
+
+    TEST_MINIFY("[]", " [ ] ", 0);
+    TEST_MINIFY("\"  spaces  kept  \"", "  \"  spaces  kept  \"  ", 0);
+    TEST_MINIFY("[\"0123456789abcdef0123456789 \\\" \\\\\"]", "[ \"0123456789abcdef0123456789 \\\" \\\\\" ]", 0);
+    TEST_MINIFY("1e309", " 1e309 ", 0);
+    TEST_MINIFY("\"\\uD834\\uDD1E\\u0001\"", "\"\\uD834\\uDD1E\\u0001\"", 0);
+    TEST_MINIFY("\"\xF0\x9D\x84\x9E\\u0001\\n/\"", "\"\\uD834\\uDD1E\\u0001\\n\\/\"", DULL_MINIFY_REESCAPE);
+
+    EXPECT_EQ_INT(DULL_PARSE_OK, dull_minify_inplace(json, &len, 0));
+    json[len] = '\0';
+    EXPECT_EQ_STRING("{\"a\":[1,-2.5e+3,true,false,null],\"b\\u00e9\\/\":{},\"c\":[]}", json, len);
+
+    /* a failed in-place minify leaves the buffer and its length alone */
+    {
+        char bad[] = "[ 1 , 2 , x ]";
+        size_t bad_len = sizeof(bad) - 1;
+        EXPECT_EQ_INT(DULL_PARSE_INVALID_VALUE, dull_minify_inplace(bad, &bad_len, 0));
+        EXPECT_EQ_SIZE_T(sizeof(bad) - 1, bad_len);
+        EXPECT_EQ_STRING("[ 1 , 2 , x ]", bad, bad_len);
+    }
+
+    /* the input need not be terminated */
+    {
+        char out[8];
+        size_t out_len;
+        EXPECT_EQ_INT(DULL_PARSE_OK, dull_minify("[1]x", 3, out, &out_len, 0));
+        EXPECT_EQ_SIZE_T(3, out_len);
+        EXPECT_EQ_INT(DULL_PARSE_MISS_QUOTATION_MARK, dull_minify("\"ab\"", 3, out, &out_len, 0));
+        EXPECT_EQ_INT(DULL_PARSE_INVALID_VALUE, dull_minify("tru", 3, out, &out_len, 0));
+    }
+
+    TEST_MINIFY_ERROR(DULL_PARSE_EXPECT_VALUE, "  ");
+    TEST_MINIFY_ERROR(DULL_PARSE_INVALID_VALUE, "nul");
+    TEST_MINIFY_ERROR(DULL_PARSE_ROOT_NOT_SINGULAR, "01");
+    TEST_MINIFY_ERROR(DULL_PARSE_ROOT_NOT_SINGULAR, "[] x");
+    TEST_MINIFY_ERROR(DULL_PARSE_INVALID_STRING_ESCAPE, "\"\\v\"");
+    TEST_MINIFY_ERROR(DULL_PARSE_INVALID_STRING_ESCAPE, "\"abc\\");
+    TEST_MINIFY_ERROR(DULL_PARSE_INVALID_STRING_CHAR, "\"0123456789abcdef\x01\"");
+    TEST_MINIFY_ERROR(DULL_PARSE_INVALID_UNICODE_HEX, "\"\\u12\"");
+    TEST_MINIFY_ERROR(DULL_PARSE_INVALID_UNICODE_SURROGATE, "\"\\uD800\\u0041\"");
+    TEST_MINIFY_ERROR(DULL_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, "[1 2]");
+    TEST_MINIFY_ERROR(DULL_PARSE_MISS_KEY, "{1:2}");
+    TEST_MINIFY_ERROR(DULL_PARSE_MISS_COLON, "{\"a\" 2}");
+    TEST_MINIFY_ERROR(DULL_PARSE_MISS_COMMA_OR_CURLY_BRACKET, "{\"a\":2 \"b\":3}");
+
+    /* whitespace between scalar bytes still counts once the rest is compacted */
+    TEST_MINIFY_ERROR(DULL_PARSE_INVALID_VALUE, "[tr ue]");
+    TEST_MINIFY_ERROR(DULL_PARSE_INVALID_VALUE, "[- 1]");
+    TEST_MINIFY_ERROR(DULL_PARSE_ROOT_NOT_SINGULAR, "1 .5");
+    TEST_MINIFY_ERROR(DULL_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, "[true false]");
+
+    /* across the 64-byte blocks the compactor classifies */
+    {
+        char in[160], out[160];
+        size_t out_len, in_len;
+        memset(in, ' ', sizeof(in));
+        memcpy(in, "[\"", 2);
+        memcpy(in + 62, "\\\"\"", 3);
+        memcpy(in + 100, ",12]", 4);
+        EXPECT_EQ_INT(DULL_PARSE_OK, dull_minify(in, sizeof(in), out, &out_len, 0));
+        EXPECT_EQ_SIZE_T(69, out_len);
+        EXPECT_EQ_INT(0, memcmp(out + 62, "\\\"\",12]", 7));
+
+        memset(in, ' ', sizeof(in));
+        memcpy(in + 62, "[12", 3);
+        memcpy(in + 130, "3]", 2);
+        in_len = sizeof(in);
+        EXPECT_EQ_INT(DULL_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, dull_minify_inplace(in, &in_len, 0));
+        EXPECT_EQ_SIZE_T(sizeof(in), in_len);
+        EXPECT_EQ_INT(0, memcmp(in + 62, "[12 ", 4));
+
+        memcpy(in + 65, "3]", 2);
+        memset(in + 130, ' ', 2);
+        EXPECT_EQ_INT(DULL_PARSE_OK, dull_minify_inplace(in, &in_len, 0));
+        EXPECT_EQ_SIZE_T(5, in_len);
+        EXPECT_EQ_INT(0, memcmp(in, "[123]", 5));
+    }
 }
 
 int main() {
@@ -421,6 +1499,18 @@ int main() {
 #endif
     test_parse();
     test_access();
+    test_equal();
+    test_copy();
+    test_move();
+    test_swap();
+    test_snapshot();
+    test_snapshot_corrupt();
+    test_document();
+    test_writer();
+    test_writer_value();
+    test_minify();
+    test_patch();
+    test_async_parse();
     printf("%d/%d (%3.2f%%) passed\n", test_pass, test_count, test_pass * 100.0 / test_count);
     return main_ret;
 }
\ No newline at end of file
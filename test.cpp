@@ -0,0 +1,262 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <utility>
+#include "dulljson.hpp"
+
+static int main_ret = 0;
+static int test_count = 0;
+static int test_pass = 0;
+
+#define EXPECT_EQ_BASE(equality, expect, actual, format) \
+    do {\
+        test_count++;\
+        if (equality)\
+            test_pass++;\
+        else {\
+            fprintf(stderr, "%s:%d: expect: " format " actual: " format "\n", __FILE__, __LINE__, expect, actual);\
+            main_ret = 1;\
+        }\
+    } while(0)
+
+#define EXPECT_EQ_INT(expect, actual) EXPECT_EQ_BASE((expect) == (actual), expect, actual, "%d")
+#define EXPECT_EQ_DOUBLE(expect, actual) EXPECT_EQ_BASE((expect) == (actual), expect, actual, "%.17g")
+#define EXPECT_EQ_SIZE_T(expect, actual) EXPECT_EQ_BASE((expect) == (actual), (size_t)expect, (size_t)actual, "%zu")
+#define EXPECT_EQ_VIEW(expect, actual) \
+    EXPECT_EQ_BASE(std::string_view(expect) == (actual), expect, std::string(actual).c_str(), "%s")
+#define EXPECT_TRUE(actual) EXPECT_EQ_BASE((actual) != 0, "true", "false", "%s")
+
+static void test_document() {
+    dull::document d;
+    EXPECT_EQ_INT(DULL_PARSE_OK, d.parse("{\"n\":null,\"b\":true,\"i\":42,\"s\":\"Hello\\u0000World\",\"a\":[3,1,2]}"));
+    dull::value root = d.root();
+    EXPECT_TRUE(root.is_object());
+    EXPECT_EQ_SIZE_T(5, root.size());
+    EXPECT_TRUE(root["n"].is_null());
+    EXPECT_TRUE(root["b"].get<bool>());
+    EXPECT_EQ_INT(42, root["i"].get<int>());
+    EXPECT_EQ_DOUBLE(42.0, root["i"].get<double>());
+    EXPECT_EQ_SIZE_T(11, root["s"].get<std::string_view>().size());
+    EXPECT_TRUE(root["s"].get<std::string_view>() == std::string_view("Hello\0World", 11));
+    EXPECT_TRUE(!root["missing"]);
+
+    /* the checked get refuses numbers that don't fit, or values of another type */
+    {
+        int i = 0;
+        unsigned u = 0;
+        double x = 0;
+        std::string_view sv;
+        dull::document n;
+        EXPECT_EQ_INT(DULL_PARSE_OK, n.parse("[1e30,-1,2.5,4294967295]"));
+        EXPECT_EQ_INT(DULL_PARSE_TYPE_MISMATCH, n.root()[0].get(i));
+        EXPECT_EQ_INT(DULL_PARSE_TYPE_MISMATCH, n.root()[1].get(u));
+        EXPECT_EQ_INT(DULL_PARSE_TYPE_MISMATCH, n.root()[2].get(i));
+        EXPECT_EQ_INT(DULL_PARSE_OK, n.root()[3].get(u));
+        EXPECT_TRUE(u == 4294967295u);
+        EXPECT_EQ_INT(DULL_PARSE_OK, n.root()[0].get(x));
+        EXPECT_EQ_DOUBLE(1e30, x);
+        EXPECT_EQ_INT(DULL_PARSE_OK, root["i"].get(i));
+        EXPECT_EQ_INT(42, i);
+        EXPECT_EQ_INT(DULL_PARSE_TYPE_MISMATCH, root["s"].get(i));
+        EXPECT_EQ_INT(DULL_PARSE_TYPE_MISMATCH, root["i"].get(sv));
+        EXPECT_EQ_INT(DULL_PARSE_OK, root["s"].get(sv));
+        EXPECT_EQ_SIZE_T(11, sv.size());
+    }
+
+    /* string views point straight into the tree */
+    EXPECT_TRUE(root["s"].get<std::string_view>().data() == dull_get_string(root["s"].raw()));
+
+    dull::document moved(std::move(d));
+    EXPECT_EQ_INT(DULL_NULL, dull_get_type(d.raw()));
+    EXPECT_TRUE(moved.root()["a"].is_array());
+
+    dull::document copied = moved.copy();
+    moved = dull::document();
+    EXPECT_EQ_SIZE_T(3, copied.root()["a"].size());
+    EXPECT_EQ_INT(2, copied.root()["a"][2].get<int>());
+
+    /* parsing again replaces the old tree */
+    EXPECT_EQ_INT(DULL_PARSE_OK, copied.parse("[\"again\"]"));
+    EXPECT_EQ_SIZE_T(1, copied.root().size());
+    EXPECT_EQ_INT(DULL_PARSE_INVALID_VALUE, copied.parse(std::string("[nul]")));
+    EXPECT_TRUE(copied.root().is_null());
+}
+
+static void test_iterators() {
+    dull::document d;
+    EXPECT_EQ_INT(DULL_PARSE_OK, d.parse("{\"a\":[3,1,2],\"k1\":\"v1\",\"k2\":\"v2\"}"));
+    dull::value a = d.root()["a"];
+
+    double sum = 0;
+    for (dull::value e : a)
+        sum += e.get<double>();
+    EXPECT_EQ_DOUBLE(6.0, sum);
+    EXPECT_EQ_INT(3, (int)(a.end() - a.begin()));
+    EXPECT_EQ_INT(2, a.begin()[2].get<int>());
+    EXPECT_TRUE(std::max_element(a.begin(), a.end(), [](dull::value x, dull::value y) {
+        return x.get<double>() < y.get<double>();
+    }) == a.begin());
+
+    std::string keys;
+    for (dull::member m : d.root().members())
+        keys.append(m.key);
+    EXPECT_EQ_VIEW("ak1k2", keys);
+    EXPECT_EQ_VIEW("v2", d.root().members().begin()[2].value.get<std::string_view>());
+}
+
+static void test_shared_document() {
+    dull::document d;
+    EXPECT_EQ_INT(DULL_PARSE_OK, d.parse("{\"k\":[1,2],\"s\":\"v\"}"));
+    dull::shared_document shared(std::move(d));
+    EXPECT_EQ_INT(DULL_NULL, dull_get_type(d.raw()));
+    dull::shared_document other = shared;
+    shared = dull::shared_document();
+    EXPECT_TRUE(!shared);
+    EXPECT_EQ_SIZE_T(2, other.find(other.root(), "k").size());
+    EXPECT_EQ_VIEW("v", other.root()["s"].get<std::string_view>());
+    for (dull::const_member m : other.root().members())
+        EXPECT_TRUE(m.value.is_array() || m.value.is_string());
+    EXPECT_EQ_INT(2, other.root()["k"].begin()[1].get<int>());
+}
+
+/* a frozen tree only hands out read-only views, and views only convert toward const */
+static_assert(std::is_same_v<decltype(std::declval<const dull::shared_document&>().root().raw()), const dull_value*>, "");
+static_assert(std::is_convertible_v<dull::value, dull::const_value>, "");
+static_assert(!std::is_convertible_v<dull::const_value, dull::value>, "");
+
+struct point {
+    double x, y;
+    std::string label;
+};
+DULL_FIELDS(point, DULL_FIELD(point, x), DULL_FIELD(point, y), DULL_FIELD(point, label));
+
+struct shape {
+    std::string name;
+    bool closed;
+    int layer;
+    std::vector<point> points;
+    std::vector<std::string> tags;
+};
+DULL_FIELDS(shape, DULL_FIELD(shape, name), DULL_FIELD(shape, closed), DULL_FIELD(shape, layer),
+    DULL_FIELD(shape, points), DULL_FIELD(shape, tags));
+
+struct counters {
+    unsigned char small;
+    long long big;
+    float ratio;
+    std::vector<bool> flags;
+};
+DULL_FIELDS(counters, DULL_FIELD(counters, small), DULL_FIELD(counters, big), DULL_FIELD(counters, ratio),
+    DULL_FIELD(counters, flags));
+
+/* keys resolve at compile time */
+static_assert(dull::detail::keys_of<shape>::table.find("points", 6) == 3, "");
+static_assert(dull::detail::keys_of<shape>::table.find("point", 5) == -1, "");
+
+static void test_from_json() {
+    shape s;
+    s.layer = -1;
+    EXPECT_EQ_INT(DULL_PARSE_OK, dull::from_json(
+        " { \"name\" : \"tri\\u00E2ngulo\", \"closed\": true, \"extra\": {\"a\":[1,{\"b\":null}]},"
+        "\"points\":[{\"x\":0,\"y\":0},{\"x\":1.5,\"y\":-2,\"label\":\"p\\n1\"},{}],"
+        "\"tags\":[\"a\",\"\"] } ", s));
+    EXPECT_EQ_VIEW("tri\xC3\xA2ngulo", s.name);
+    EXPECT_TRUE(s.closed);
+    EXPECT_EQ_INT(-1, s.layer);
+    EXPECT_EQ_SIZE_T(3, s.points.size());
+    EXPECT_EQ_DOUBLE(1.5, s.points[1].x);
+    EXPECT_EQ_DOUBLE(-2.0, s.points[1].y);
+    EXPECT_EQ_VIEW("p\n1", s.points[1].label);
+    EXPECT_EQ_SIZE_T(2, s.tags.size());
+    EXPECT_EQ_VIEW("", s.tags[1]);
+
+    point p;
+    EXPECT_EQ_INT(DULL_PARSE_TYPE_MISMATCH, dull::from_json("{\"x\":\"1\"}", p));
+    EXPECT_EQ_INT(DULL_PARSE_TYPE_MISMATCH, dull::from_json("[]", p));
+    EXPECT_EQ_INT(DULL_PARSE_MISS_COLON, dull::from_json("{\"x\" 1}", p));
+    EXPECT_EQ_INT(DULL_PARSE_MISS_COMMA_OR_CURLY_BRACKET, dull::from_json("{\"x\":1 \"y\":2}", p));
+    EXPECT_EQ_INT(DULL_PARSE_INVALID_VALUE, dull::from_json("{\"z\":[nul]}", p));
+    EXPECT_EQ_INT(DULL_PARSE_ROOT_NOT_SINGULAR, dull::from_json("{} x", p));
+    EXPECT_EQ_INT(DULL_PARSE_EXPECT_VALUE, dull::from_json("{\"y\":", p));
+
+    /* numbers must fit the field exactly */
+    counters c{};
+    EXPECT_EQ_INT(DULL_PARSE_OK, dull::from_json(
+        "{\"small\":255,\"big\":-9007199254740992,\"ratio\":0.5,\"flags\":[true,false,true]}", c));
+    EXPECT_EQ_INT(255, c.small);
+    EXPECT_TRUE(c.big == -9007199254740992LL);
+    EXPECT_EQ_DOUBLE(0.5, c.ratio);
+    EXPECT_EQ_SIZE_T(3, c.flags.size());
+    EXPECT_TRUE(c.flags[0] && !c.flags[1] && c.flags[2]);
+    EXPECT_EQ_INT(DULL_PARSE_TYPE_MISMATCH, dull::from_json("{\"small\":256}", c));
+    EXPECT_EQ_INT(DULL_PARSE_TYPE_MISMATCH, dull::from_json("{\"small\":-1}", c));
+    EXPECT_EQ_INT(DULL_PARSE_TYPE_MISMATCH, dull::from_json("{\"small\":1.5}", c));
+    EXPECT_EQ_INT(DULL_PARSE_TYPE_MISMATCH, dull::from_json("{\"big\":1e30}", c));
+    EXPECT_EQ_INT(DULL_PARSE_TYPE_MISMATCH, dull::from_json("{\"big\":9223372036854775808}", c));
+    EXPECT_EQ_INT(DULL_PARSE_TYPE_MISMATCH, dull::from_json("{\"ratio\":1e300}", c));
+    EXPECT_EQ_INT(DULL_PARSE_TYPE_MISMATCH, dull::from_json("{\"flags\":[1]}", c));
+    EXPECT_EQ_INT(DULL_PARSE_TYPE_MISMATCH, dull::from_json("{\"layer\":1e30}", s));
+}
+
+#ifdef DULL_HAVE_COROUTINE
+/* just enough of a task type and an event loop to drive async_parse */
+struct test_task {
+    struct promise_type {
+        test_task get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() {}
+    };
+};
+
+static test_task test_parse_task(const char* json, int* code, int* slices, dull::document* out, std::deque<std::coroutine_handle<>>* loop) {
+    dull::async_parse parse(json, 4);
+    auto schedule = [loop](std::coroutine_handle<> h) { loop->push_back(h); };
+    while ((*code = co_await parse.step(schedule)) == DULL_PARSE_PENDING)
+        ++*slices;
+    *out = parse.take();
+}
+
+static void test_async_parse() {
+    std::deque<std::coroutine_handle<>> loop;
+    dull::document a, b;
+    int code_a = -1, code_b = -1, slices_a = 0, slices_b = 0, turns = 0;
+
+    test_parse_task("{\"a\":[1,2,{\"b\":\"long string here\"}],\"c\":true}", &code_a, &slices_a, &a, &loop);
+    test_parse_task("[1 2]", &code_b, &slices_b, &b, &loop);
+    while (!loop.empty()) {
+        auto h = loop.front();
+        loop.pop_front();
+        h.resume();
+        turns++;
+    }
+    EXPECT_EQ_INT(DULL_PARSE_OK, code_a);
+    EXPECT_EQ_INT(DULL_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, code_b);
+    EXPECT_TRUE(slices_a > 5);
+    EXPECT_EQ_INT(slices_a + slices_b, turns);
+    EXPECT_EQ_VIEW("long string here", a.root()["a"][2]["b"].get<std::string_view>());
+    EXPECT_TRUE(a.root()["c"].get<bool>());
+    EXPECT_TRUE(b.root().is_null());
+
+    dull::async_parse parse("[1, 2, 3]", 1);
+    while (parse.poll() == DULL_PARSE_PENDING);
+    EXPECT_TRUE(parse.done());
+    EXPECT_EQ_SIZE_T(3, parse.take().root().size());
+}
+#endif
+
+int main() {
+    test_document();
+    test_iterators();
+    test_shared_document();
+    test_from_json();
+#ifdef DULL_HAVE_COROUTINE
+    test_async_parse();
+#endif
+    printf("%d/%d (%3.2f%%) passed\n", test_pass, test_count, test_pass * 100.0 / test_count);
+    return main_ret;
+}
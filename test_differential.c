@@ -0,0 +1,526 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "dulljson.h"
+
+/*
+ * generates large random and adversarial documents, runs each one through
+ * every engine and mode, and checks they all build the same tree. each generator
+ * also has a parse time budget, in nanoseconds per input byte, which the medians
+ * of TIME_RUNS parses of its documents must meet. DULL_TIME_SCALE multiplies
+ * it for slow builds such as sanitizer runs. the suite is also built with
+ * DULL_NO_SSE2, so minify's scalar paths see the same documents.
+ *
+ *     test_differential [seed]
+ */
+
+static int main_ret = 0;
+static int test_count = 0;
+static int test_pass = 0;
+static const char* test_case = "";
+
+#define EXPECT_BASE(equality, format, ...) \
+    do {\
+        test_count++;\
+        if (equality)\
+            test_pass++;\
+        else {\
+            fprintf(stderr, "%s:%d: %s: " format "\n", __FILE__, __LINE__, test_case, __VA_ARGS__);\
+            main_ret = 1;\
+        }\
+    } while(0)
+
+#define EXPECT_EQ_INT(expect, actual) EXPECT_BASE((expect) == (actual), "expect: %d actual: %d", (int)(expect), (int)(actual))
+#define EXPECT_EQ_SIZE_T(expect, actual) EXPECT_BASE((expect) == (actual), "expect: %zu actual: %zu", (size_t)(expect), (size_t)(actual))
+#define EXPECT_SAME_TREE(expect, actual, engine) \
+    EXPECT_BASE(dull_equal(expect, actual) && dull_hash(expect) == dull_hash(actual), "%s built a different tree", engine)
+
+#define JSON_PATH "dull_differential.json"
+#define SNAPSHOT_PATH "dull_differential.bin"
+
+/* xorshift64*, so every run with the same seed sees the same documents */
+static unsigned long long rng_state;
+
+static unsigned rng(unsigned n) {
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return (unsigned)((rng_state * 2685821657736338717ULL) >> 33) % n;
+}
+
+typedef struct {
+    char* p;
+    size_t len, cap;
+} buffer;
+
+static void put(buffer* b, const char* s, size_t len) {
+    if (b->len + len + 1 > b->cap) {
+        while (b->len + len + 1 > b->cap)
+            b->cap = b->cap ? b->cap * 2 : 4096;
+        b->p = (char*)realloc(b->p, b->cap);
+    }
+    memcpy(b->p + b->len, s, len);
+    b->len += len;
+    b->p[b->len] = '\0';
+}
+
+static void puts_(buffer* b, const char* s) {
+    put(b, s, strlen(s));
+}
+
+static void whitespace(buffer* b) {
+    static const char* const ws[] = { "", "", "", " ", "\n  ", "\t", "\r\n" };
+    puts_(b, ws[rng(sizeof(ws) / sizeof(ws[0]))]);
+}
+
+static void gen_number(buffer* b) {
+    char num[64];
+    int i, n;
+    switch (rng(6)) {
+    case 0:
+        sprintf(num, "%d", (int)rng(2000000) - 1000000);
+        puts_(b, num);
+        break;
+    case 1:
+        sprintf(num, "%s%u.%u", rng(2) ? "-" : "", rng(1000), rng(100000));
+        puts_(b, num);
+        break;
+    case 2:
+        sprintf(num, "%u.%ue%s%u", rng(10), rng(1000), rng(2) ? "-" : "+", rng(300));
+        puts_(b, num);
+        break;
+    case 3:
+        /* hundreds of digits that still fit in a double */
+        puts_(b, rng(2) ? "-" : "");
+        put(b, "123456789" + rng(9), 1);
+        for (i = 0, n = 1 + rng(300); i < n; i++)
+            put(b, "0123456789" + rng(10), 1);
+        sprintf(num, "e-%u", n);
+        puts_(b, num);
+        break;
+    case 4:
+        puts_(b, rng(2) ? "1.7976931348623157e308" : "4.9e-324");
+        break;
+    default:
+        puts_(b, rng(2) ? "0" : "-0.0");
+    }
+}
+
+static void gen_string(buffer* b, size_t len) {
+    static const char* const escapes[] = { "\\n", "\\t", "\\\"", "\\\\", "\\/", "\\b", "\\f", "\\r", "\\u0000", "\\u001F", "\\u00e9" };
+    static const char* const utf8[] = { "\xC3\xA9", "\xE2\x82\xAC", "\xF0\x9D\x84\x9E" };
+    char esc[16];
+    size_t i;
+    put(b, "\"", 1);
+    for (i = 0; i < len; i++) {
+        unsigned r = rng(20);
+        if (r < 12)
+            put(b, "abcdefghijklmnopqrstuvwxyz ABC" + rng(30), 1);
+        else if (r < 15)
+            puts_(b, escapes[rng(sizeof(escapes) / sizeof(escapes[0]))]);
+        else if (r < 17)
+            puts_(b, utf8[rng(3)]);
+        else if (r < 19) {
+            /* a surrogate pair, spelled in either case */
+            sprintf(esc, rng(2) ? "\\u%04X\\u%04X" : "\\u%04x\\u%04x", 0xD800 + rng(0x400), 0xDC00 + rng(0x400));
+            puts_(b, esc);
+        }
+        else {
+            sprintf(esc, "\\u%04X", 0x20 + rng(0xD7FF - 0x20));
+            puts_(b, esc);
+        }
+    }
+    put(b, "\"", 1);
+}
+
+static void gen_value(buffer* b, int depth, size_t width);
+
+static void gen_container(buffer* b, int object, int depth, size_t width) {
+    size_t i, n = rng((unsigned)width + 1);
+    put(b, object ? "{" : "[", 1);
+    for (i = 0; i < n; i++) {
+        if (i > 0)
+            put(b, ",", 1);
+        whitespace(b);
+        if (object) {
+            gen_string(b, rng(12));
+            whitespace(b);
+            put(b, ":", 1);
+            whitespace(b);
+        }
+        gen_value(b, depth + 1, width);
+        whitespace(b);
+    }
+    put(b, object ? "}" : "]", 1);
+}
+
+static void gen_value(buffer* b, int depth, size_t width) {
+    unsigned r = rng(depth < 6 ? 10 : 7);
+    switch (r) {
+    case 0: puts_(b, "null"); break;
+    case 1: puts_(b, "true"); break;
+    case 2: puts_(b, "false"); break;
+    case 3:
+    case 4: gen_number(b); break;
+    case 5:
+    case 6: gen_string(b, rng(40)); break;
+    default: gen_container(b, r != 7, depth, width);
+    }
+}
+
+/* fills b with roughly size bytes of one kind of document */
+typedef void (*generator)(buffer* b, size_t size);
+
+static void gen_random(buffer* b, size_t size) {
+    put(b, "[", 1);
+    while (b->len < size) {
+        if (b->len > 1)
+            put(b, ",", 1);
+        gen_container(b, 1, 1, 8);
+    }
+    put(b, "]", 1);
+}
+
+static void gen_deep(buffer* b, size_t size) {
+    size_t i, depth = size / 8 < 2000 ? size / 8 : 2000;
+    while (b->len < size) {
+        put(b, b->len == 0 ? "[" : ",", 1);
+        for (i = 0; i < depth; i++)
+            puts_(b, i % 2 ? "{\"k\":" : "[");
+        gen_number(b);
+        for (i = depth; i-- > 0; )
+            puts_(b, i % 2 ? "}" : "]");
+    }
+    put(b, "]", 1);
+}
+
+static void gen_escapes(buffer* b, size_t size) {
+    put(b, "[", 1);
+    while (b->len < size) {
+        if (b->len > 1)
+            put(b, ",", 1);
+        gen_string(b, 4096);
+    }
+    put(b, "]", 1);
+}
+
+static void gen_numbers(buffer* b, size_t size) {
+    put(b, "[", 1);
+    while (b->len < size) {
+        if (b->len > 1)
+            put(b, ",", 1);
+        gen_number(b);
+    }
+    put(b, "]", 1);
+}
+
+static void gen_literals(buffer* b, size_t size) {
+    static const char* const literals[] = { "true", "false", "null" };
+    put(b, "[", 1);
+    while (b->len < size) {
+        if (b->len > 1)
+            put(b, ",", 1);
+        puts_(b, literals[rng(3)]);
+    }
+    put(b, "]", 1);
+}
+
+static int write_file(const char* path, const char* data, size_t len) {
+    FILE* fp = fopen(path, "wb");
+    size_t n;
+    if (fp == NULL)
+        return -1;
+    n = fwrite(data, 1, len, fp);
+    fclose(fp);
+    return n == len ? 0 : -1;
+}
+
+static int write_buffer(void* user, const char* data, size_t len) {
+    put((buffer*)user, data, len);
+    return 0;
+}
+
+static size_t depth_of(const dull_value* v) {
+    size_t i, d, max = 0;
+    if (v->type == DULL_ARRAY)
+        for (i = 0; i < v->u.a.size; i++)
+            if ((d = depth_of(&v->u.a.e[i])) > max)
+                max = d;
+    if (v->type == DULL_OBJECT)
+        for (i = 0; i < v->u.o.size; i++)
+            if ((d = depth_of(&v->u.o.m[i].v)) > max)
+                max = d;
+    return v->type == DULL_ARRAY || v->type == DULL_OBJECT ? max + 1 : 0;
+}
+
+static int parse_async(dull_value* v, const char* json, size_t budget, dull_parse_result* r) {
+    dull_async_parser* p = dull_async_parse_begin(v, json);
+    while (dull_async_parse_step(p, budget) == DULL_PARSE_PENDING);
+    return dull_async_parse_end(p, r);
+}
+
+/* parses text as json and compares it with expect */
+static void check_text(const dull_value* expect, const char* json, size_t len, const char* engine) {
+    dull_value v;
+    char* copy = (char*)malloc(len + 1);
+    memcpy(copy, json, len);
+    copy[len] = '\0';
+    DULL_INIT(&v);
+    EXPECT_EQ_INT(DULL_PARSE_OK, dull_parse(&v, copy));
+    EXPECT_SAME_TREE(expect, &v, engine);
+    dull_free(&v);
+    free(copy);
+}
+
+/* what dull_minify writes without DULL_MINIFY_REESCAPE, worked out a byte at a time */
+static void strip_whitespace(buffer* b, const char* json, size_t len) {
+    int in_string = 0;
+    size_t i;
+    b->len = 0;
+    for (i = 0; i < len; i++) {
+        if (in_string) {
+            if (json[i] == '\\') {
+                put(b, json + i++, 2);
+                continue;
+            }
+            in_string = json[i] != '"';
+        }
+        else if (json[i] == ' ' || json[i] == '\t' || json[i] == '\n' || json[i] == '\r')
+            continue;
+        else
+            in_string = json[i] == '"';
+        put(b, json + i, 1);
+    }
+}
+
+static void check_valid(const char* json, size_t len) {
+    dull_value ref, v;
+    dull_parse_result r;
+    dull_parse_stats stats;
+    dull_writer w;
+    dull_reader reader;
+    dull_document* d;
+    buffer text = { NULL, 0, 0 };
+    char wbuf[4096];
+    char* out = (char*)malloc(len + 1);
+    size_t i, out_len, in_len;
+
+    DULL_INIT(&ref);
+    DULL_INIT(&v);
+    EXPECT_EQ_INT(DULL_PARSE_OK, dull_parse(&ref, json));
+    EXPECT_SAME_TREE(&ref, &ref, "dull_parse");
+
+    EXPECT_EQ_INT(DULL_PARSE_OK, dull_parse_ex(&v, json, &r));
+    EXPECT_SAME_TREE(&ref, &v, "dull_parse_ex");
+    dull_free(&v);
+
+    EXPECT_EQ_INT(DULL_PARSE_OK, dull_parse_stats_ex(&v, json, &stats));
+    EXPECT_SAME_TREE(&ref, &v, "dull_parse_stats_ex");
+    dull_free(&v);
+
+    EXPECT_EQ_INT(0, write_file(JSON_PATH, json, len));
+    EXPECT_EQ_INT(DULL_PARSE_OK, dull_parse_file(&v, JSON_PATH, 0));
+    EXPECT_SAME_TREE(&ref, &v, "dull_parse_file");
+    dull_free(&v);
+    EXPECT_EQ_INT(DULL_PARSE_OK, dull_parse_file(&v, JSON_PATH, DULL_FILE_POPULATE | DULL_FILE_HUGEPAGE));
+    EXPECT_SAME_TREE(&ref, &v, "dull_parse_file with hints");
+    dull_free(&v);
+
+    EXPECT_EQ_INT(DULL_PARSE_OK, parse_async(&v, json, 1, NULL));
+    EXPECT_SAME_TREE(&ref, &v, "dull_async_parse_step(1)");
+    dull_free(&v);
+    EXPECT_EQ_INT(DULL_PARSE_OK, parse_async(&v, json, 65536, NULL));
+    EXPECT_SAME_TREE(&ref, &v, "dull_async_parse_step(65536)");
+    dull_free(&v);
+
+    dull_copy(&v, &ref);
+    EXPECT_SAME_TREE(&ref, &v, "dull_copy");
+    EXPECT_EQ_INT(0, dull_save_snapshot(&v, SNAPSHOT_PATH));
+    dull_free(&v);
+    EXPECT_EQ_INT(DULL_PARSE_OK, dull_load_snapshot(&v, SNAPSHOT_PATH));
+    EXPECT_SAME_TREE(&ref, &v, "dull_load_snapshot");
+
+    /* an object root is looked up through the document index */
+    d = dull_freeze(&v);
+    if (ref.type == DULL_OBJECT)
+        for (i = 0; i < ref.u.o.size; i++) {
+            const dull_member* m = &ref.u.o.m[i];
+            const dull_value* found = dull_document_find(d, dull_document_root(d), m->k, m->klen);
+            EXPECT_BASE(found != NULL && dull_equal(found, dull_find_object_value(&ref, m->k, m->klen)), "%s", "dull_document_find");
+        }
+    EXPECT_SAME_TREE(&ref, dull_document_root(d), "dull_freeze");
+    dull_document_release(d);
+
+    if (depth_of(&ref) <= DULL_WRITER_MAX_DEPTH) {
+        dull_writer_init(&w, wbuf, sizeof(wbuf), write_buffer, &text);
+        EXPECT_EQ_INT(DULL_WRITE_OK, dull_writer_value(&w, &ref));
+        EXPECT_EQ_INT(DULL_WRITE_OK, dull_writer_flush(&w));
+        check_text(&ref, text.p, text.len, "dull_writer_value");
+    }
+
+    EXPECT_EQ_INT(DULL_PARSE_OK, dull_minify(json, len, out, &out_len, 0));
+    check_text(&ref, out, out_len, "dull_minify");
+    strip_whitespace(&text, json, len);
+    EXPECT_BASE(out_len == text.len && memcmp(out, text.p, out_len) == 0, "%s", "dull_minify dropped the wrong bytes");
+    EXPECT_EQ_INT(DULL_PARSE_OK, dull_minify(json, len, out, &out_len, DULL_MINIFY_REESCAPE));
+    check_text(&ref, out, out_len, "dull_minify with DULL_MINIFY_REESCAPE");
+    memcpy(out, json, len);
+    in_len = len;
+    EXPECT_EQ_INT(DULL_PARSE_OK, dull_minify_inplace(out, &in_len, DULL_MINIFY_REESCAPE));
+    EXPECT_EQ_SIZE_T(out_len, in_len);
+    check_text(&ref, out, in_len, "dull_minify_inplace");
+    free(text.p);
+
+    dull_reader_init(&reader, json);
+    EXPECT_EQ_INT(DULL_PARSE_OK, dull_reader_skip(&reader));
+    EXPECT_EQ_INT('\0', dull_reader_peek(&reader));
+    dull_reader_free(&reader);
+
+    free(out);
+    dull_free(&ref);
+}
+
+/* every engine must reject a broken document with the same code, at the same offset */
+static void check_invalid(const char* json, size_t len) {
+    dull_value v;
+    dull_parse_result ref, r;
+    char out[4096];
+    size_t out_len;
+
+    DULL_INIT(&v);
+    if (dull_parse_ex(&v, json, &ref) == DULL_PARSE_OK) {
+        dull_free(&v);
+        return;
+    }
+    EXPECT_EQ_INT(DULL_NULL, v.type);
+
+    EXPECT_EQ_INT(ref.code, parse_async(&v, json, 1, &r));
+    EXPECT_EQ_SIZE_T(ref.offset, r.offset);
+    EXPECT_EQ_INT(ref.code, parse_async(&v, json, 7, &r));
+    EXPECT_EQ_SIZE_T(ref.offset, r.offset);
+
+    EXPECT_EQ_INT(0, write_file(JSON_PATH, json, len));
+    EXPECT_EQ_INT(ref.code, dull_parse_file_ex(&v, JSON_PATH, 0, &r));
+    EXPECT_EQ_SIZE_T(ref.offset, r.offset);
+    EXPECT_EQ_SIZE_T(ref.line, r.line);
+    EXPECT_EQ_SIZE_T(ref.column, r.column);
+
+    /* minify checks the grammar only, so it reads on past a number out of range */
+    if (len <= sizeof(out) && ref.code != DULL_PARSE_NUMBER_TOO_BIG)
+        EXPECT_EQ_INT(ref.code, dull_minify(json, len, out, &out_len, 0));
+}
+
+/* damages a copy of json in one of the ways a truncated or corrupted body would be */
+static void mutate(buffer* b, const char* json, size_t len) {
+    static const char junk[] = "[]{}\",:\\ x0-.eE\x01\x80";
+    size_t at = rng((unsigned)len);
+    b->len = 0;
+    switch (rng(4)) {
+    case 0:
+        put(b, json, at);
+        break;
+    case 1:
+        put(b, json, len);
+        b->p[at] = junk[rng(sizeof(junk) - 1)];
+        break;
+    case 2:
+        put(b, json, at);
+        put(b, json + at + 1, len - at - 1);
+        break;
+    default:
+        put(b, json, at);
+        put(b, junk + rng(sizeof(junk) - 1), 1);
+        put(b, json + at, len - at);
+    }
+}
+
+static double now_ns() {
+    return clock() * 1e9 / CLOCKS_PER_SEC;
+}
+
+static int compare_double(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return x < y ? -1 : x > y;
+}
+
+/* the median of a few parses, so one preempted run doesn't trip the budget */
+#define TIME_RUNS 5
+
+static double time_parse(const char* json) {
+    double runs[TIME_RUNS];
+    int i;
+    for (i = 0; i < TIME_RUNS; i++) {
+        dull_value v;
+        double start;
+        DULL_INIT(&v);
+        start = now_ns();
+        dull_parse(&v, json);
+        runs[i] = now_ns() - start;
+        dull_free(&v);
+    }
+    qsort(runs, TIME_RUNS, sizeof(double), compare_double);
+    return runs[TIME_RUNS / 2];
+}
+
+typedef struct {
+    const char* name;
+    size_t size, count;
+} size_class;
+
+int main(int argc, char* argv[]) {
+    /* budgets are two to three times what an unoptimized build takes */
+    static const struct { const char* name; generator gen; double ns_per_byte; } generators[] = {
+        { "random", gen_random, 40 },
+        { "deep nesting", gen_deep, 80 },
+        { "long escapes", gen_escapes, 40 },
+        { "huge numbers", gen_numbers, 30 },
+        { "literal arrays", gen_literals, 30 }
+    };
+    static const size_class classes[] = {
+        { "small", 2048, 40 },
+        { "medium", 256 * 1024, 3 },
+        { "large", 4 * 1024 * 1024, 1 }
+    };
+    unsigned long long seed = argc > 1 ? strtoull(argv[1], NULL, 0) : 20261019;
+    double scale = getenv("DULL_TIME_SCALE") ? atof(getenv("DULL_TIME_SCALE")) : 1.0;
+    buffer doc = { NULL, 0, 0 }, bad = { NULL, 0, 0 };
+    char name[128];
+    size_t g, c, i, k;
+
+    rng_state = seed | 1;
+    printf("seed %llu\n", seed);
+    for (c = 0; c < sizeof(classes) / sizeof(classes[0]); c++) {
+        for (g = 0; g < sizeof(generators) / sizeof(generators[0]); g++) {
+            double elapsed = 0;
+            size_t bytes = 0;
+            for (i = 0; i < classes[c].count; i++) {
+                sprintf(name, "%s %s #%zu", classes[c].name, generators[g].name, i);
+                test_case = name;
+                doc.len = 0;
+                generators[g].gen(&doc, classes[c].size);
+
+                elapsed += time_parse(doc.p);
+                bytes += doc.len;
+
+                check_valid(doc.p, doc.len);
+                if (classes[c].size <= 4096)
+                    for (k = 0; k < 20; k++) {
+                        mutate(&bad, doc.p, doc.len);
+                        check_invalid(bad.p, bad.len);
+                    }
+            }
+            sprintf(name, "%s %s", classes[c].name, generators[g].name);
+            test_case = name;
+            printf("%-22s %10zu bytes %8.2f ns/byte\n", name, bytes, elapsed / bytes);
+            EXPECT_BASE(elapsed / bytes <= generators[g].ns_per_byte * scale,
+                "parse took %.2f ns/byte, over the budget of %.2f", elapsed / bytes, generators[g].ns_per_byte * scale);
+        }
+    }
+    remove(JSON_PATH);
+    remove(SNAPSHOT_PATH);
+    free(doc.p);
+    free(bad.p);
+    printf("%d/%d (%3.2f%%) passed\n", test_pass, test_count, test_pass * 100.0 / test_count);
+    return main_ret;
+}